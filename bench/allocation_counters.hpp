@@ -0,0 +1,15 @@
+//
+//Global allocation counters for gehu_bench, fed by the operator new
+//replacements in allocation_hooks.cpp. Those stay in a file of their own so
+//no delete is ever inlined into a caller that also sees the matching new
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+namespace allocation_counters {
+
+inline std::atomic<size_t> count{0};
+inline std::atomic<size_t> bytes{0}; // as requested
+
+} // namespace allocation_counters
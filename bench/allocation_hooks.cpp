@@ -0,0 +1,48 @@
+//
+//gehu_bench's replacement operator new and delete, which feed
+//allocation_counters. Every delete goes through the unsized one; the
+//nothrow forms call these
+#include "allocation_counters.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+void count(size_t size) {
+    allocation_counters::count.fetch_add(1, std::memory_order_relaxed);
+    allocation_counters::bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+} // namespace
+
+void* operator new(size_t size) {
+    count(size);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    count(size);
+    size_t align = static_cast<size_t>(alignment);
+    // aligned_alloc wants a multiple of the alignment
+    if (void* p = std::aligned_alloc(align, (std::max<size_t>(size, 1) + align - 1) / align * align)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new[](size_t size, std::align_val_t alignment) { return operator new(size, alignment); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete[](void* p) noexcept { operator delete(p); }
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+void operator delete[](void* p, size_t) noexcept { operator delete(p); }
+void operator delete(void* p, std::align_val_t) noexcept { operator delete(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { operator delete(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { operator delete(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { operator delete(p); }
@@ -0,0 +1,1041 @@
+//
+//gehu_bench: microbenchmarks for the compiler pipeline
+//Usage: gehu_bench [--filter=<substring>] [--scale=<statements>] [--corpus=<dir>] [--json]
+//Each benchmark builds its own synthetic input so runs are reproducible;
+//pipeline also runs every .gehu file of the corpus (lib by default)
+//Logging stays off unless a benchmark turns it on; whatever LLVM or a
+//compiled program writes is discarded while a benchmark is running
+//--json prints every result as one JSON object at the end instead of lines
+#include "allocation_counters.hpp"
+#include "ast_cache.hpp"
+#include "codegen.hpp"
+#include "flat_ast.hpp"
+#include "incremental.hpp"
+#include "lexer.hpp"
+#include "lexer_simd.hpp"
+#include "log.hpp"
+#include "parallel_lexer.hpp"
+#include "parallel_parser.hpp"
+#include "parser.hpp"
+#include "semantic_analyzer.hpp"
+#include "stats.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace {
+
+#ifndef GEHU_CORPUS_DIR
+#define GEHU_CORPUS_DIR "lib"
+#endif
+
+// Swallows everything written to it; installed on std::cout during runs.
+// LLVM writes its traces straight to fd 2 and JIT-compiled programs print
+// with printf, so fds 1 and 2 are pointed at /dev/null too
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+class QuietScope {
+public:
+    QuietScope() : saved(std::cout.rdbuf(&sink)), savedStdout(dup(1)), savedStderr(dup(2)) {
+        std::fflush(stdout);
+        int null = open("/dev/null", O_WRONLY);
+        if (null >= 0) {
+            dup2(null, 1);
+            dup2(null, 2);
+            close(null);
+        }
+    }
+    ~QuietScope() {
+        std::cout.rdbuf(saved);
+        std::fflush(stdout);
+        if (savedStdout >= 0) {
+            dup2(savedStdout, 1);
+            close(savedStdout);
+        }
+        if (savedStderr >= 0) {
+            dup2(savedStderr, 2);
+            close(savedStderr);
+        }
+    }
+private:
+    NullBuffer sink;
+    std::streambuf* saved;
+    int savedStdout;
+    int savedStderr;
+};
+
+struct Measurement {
+    double seconds;
+    size_t allocations;
+    size_t bytes;
+};
+
+Measurement measure(const std::function<void()>& body) {
+    QuietScope quiet;
+    size_t count = allocation_counters::count.load();
+    size_t bytes = allocation_counters::bytes.load();
+    auto start = std::chrono::steady_clock::now();
+    body();
+    auto end = std::chrono::steady_clock::now();
+    return Measurement{
+        std::chrono::duration<double>(end - start).count(),
+        allocation_counters::count.load() - count,
+        allocation_counters::bytes.load() - bytes
+    };
+}
+
+struct Result {
+    std::string name;
+    std::string metric;
+    double value;
+    std::string unit;
+};
+
+bool jsonOutput = false;
+std::vector<Result> results; // kept for --json
+
+void report(const std::string& name, const std::string& metric, double value, const char* unit) {
+    if (jsonOutput) {
+        results.push_back(Result{name, metric, value, unit});
+        return;
+    }
+    std::printf("%-28s %-22s %14.3f %s\n", name.c_str(), metric.c_str(), value, unit);
+}
+
+std::string jsonString(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+// {"version":1,"scale":N,"results":[{"name","metric","value","unit"}...]};
+// values that are not finite are null
+void printJson(size_t scale) {
+    std::printf("{\"version\":1,\"scale\":%zu,\"results\":[", scale);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& result = results[i];
+        char value[32] = "null";
+        if (std::isfinite(result.value)) {
+            std::snprintf(value, sizeof(value), "%.6g", result.value);
+        }
+        std::printf("%s{\"name\":%s,\"metric\":%s,\"value\":%s,\"unit\":%s}", i ? "," : "",
+                    jsonString(result.name).c_str(), jsonString(result.metric).c_str(), value,
+                    jsonString(result.unit).c_str());
+    }
+    std::printf("]}\n");
+}
+
+// A deterministic program mixing every statement kind the language has;
+// without blocks the if statements become plain shows
+std::string generateProgram(size_t statements, bool withBlocks = true) {
+    std::string out;
+    out.reserve(statements * 40);
+    size_t declared = 0;
+    for (size_t i = 0; i < statements; ++i) {
+        std::string name = "v" + std::to_string(i);
+        switch (i % 5) {
+            case 0:
+            case 1:
+                out += "let " + name + " = " + std::to_string(i) + " * (3 + " + std::to_string(i % 7) + ") - 1;\n";
+                declared = i + 1;
+                break;
+            case 2:
+                out += "let " + name + " = \"string number " + std::to_string(i) + "\";\n";
+                break;
+            case 3:
+                out += "v" + std::to_string(declared - 1) + " = v" + std::to_string(declared - 1) + " + 2; // update\n";
+                break;
+            case 4:
+                if (!withBlocks) {
+                    out += "show v" + std::to_string(declared - 1) + ";\n";
+                    break;
+                }
+                out += "if (v" + std::to_string(declared - 1) + " >= 10) {\n    show v" +
+                       std::to_string(declared - 1) + ";\n} else {\n    show \"small\";\n}\n";
+                break;
+        }
+    }
+    return out;
+}
+
+std::vector<Token> tokenize(const std::string& source, StringInterner& symbols) {
+    QuietScope quiet;
+    Lexer lexer(source, symbols);
+    std::vector<Token> tokens;
+    Token token;
+    do {
+        token = lexer.nextToken();
+        tokens.push_back(token);
+    } while (token.type != TokenType::EOF_TOKEN);
+    return tokens;
+}
+
+void benchParse(size_t scale) {
+    std::string source = generateProgram(scale);
+    StringInterner symbols;
+    std::vector<Token> tokens = tokenize(source, symbols);
+
+    std::unique_ptr<Program> program;
+    Measurement m = measure([&] {
+        Parser parser(tokens);
+        program = parser.parse();
+    });
+    report("parse", "tokens", static_cast<double>(tokens.size()), "");
+    report("parse", "time", m.seconds * 1e3, "ms");
+    report("parse", "ns/token", m.seconds * 1e9 / tokens.size(), "ns");
+    report("parse", "allocations", static_cast<double>(m.allocations), "");
+    report("parse", "allocated", m.bytes / (1024.0 * 1024.0), "MiB");
+}
+
+// Long arithmetic and comparison expressions over a few variables, so that
+// the parse is dominated by binary operators
+std::string generateExpressionProgram(size_t statements) {
+    static const char* const ops[] = {" + ", " - ", " * ", " / ", " > ", " <= ", " == ", " != "};
+    std::string out = "let a = 1;\nlet b = 2;\nlet c = 3;\n";
+    for (size_t i = 0; i < statements; ++i) {
+        out += "a = ";
+        for (size_t term = 0; term < 12; ++term) {
+            if (term % 4 == 1) {
+                out += "(b";
+                out += ops[(i + term) % 4];
+                out += "c)";
+            } else {
+                out += term % 2 ? "c" : std::to_string(term + i % 10);
+            }
+            out += term < 11 ? ops[(i * 3 + term) % 8] : ";\n";
+        }
+    }
+    return out;
+}
+
+// Parse time of operator-heavy expressions
+void benchExpressions(size_t scale) {
+    std::string source = generateExpressionProgram(scale / 2);
+    StringInterner symbols;
+    std::vector<Token> tokens = tokenize(source, symbols);
+
+    std::unique_ptr<Program> program;
+    Measurement m = measure([&] {
+        Parser parser(tokens);
+        program = parser.parse();
+    });
+    report("parse/expressions", "tokens", static_cast<double>(tokens.size()), "");
+    report("parse/expressions", "time", m.seconds * 1e3, "ms");
+    report("parse/expressions", "ns/token", m.seconds * 1e9 / tokens.size(), "ns");
+}
+
+// ParallelParser by thread count; the speedup is bounded by the cores available
+void benchParallelParse(size_t scale) {
+    std::string source = generateProgram(scale * 5);
+    StringInterner symbols;
+    std::vector<Token> tokens = tokenize(source, symbols);
+    std::vector<SourceOffset> reference;
+    {
+        QuietScope quiet;
+        Parser parser(tokens);
+        std::unique_ptr<Program> program = parser.parse();
+        for (const Statement* statement : program->statements) {
+            reference.push_back(statement->offset);
+        }
+    }
+    report("parse/parallel", "hardware threads", std::thread::hardware_concurrency(), "");
+    double serial = 0;
+    for (unsigned threads : {1u, 2u, 4u, 8u}) {
+        std::unique_ptr<Program> program;
+        ParallelParser parser(tokens);
+        parser.setThreadCount(threads);
+        Measurement m = measure([&] { program = parser.parse(); });
+        if (threads == 1) {
+            serial = m.seconds;
+        }
+        std::string name = "parse/parallel/" + std::to_string(threads);
+        report(name, "ns/token", m.seconds * 1e9 / tokens.size(), "ns");
+        report(name, "speedup", serial / m.seconds, "x");
+        bool same = program->statements.size() == reference.size();
+        for (size_t i = 0; same && i < reference.size(); ++i) {
+            same = program->statements[i]->offset == reference[i];
+        }
+        if (!same) {
+            std::fprintf(stderr, "%s statements differ from the serial parser\n", name.c_str());
+        }
+    }
+}
+
+// Lex + flat parse of a source versus loading its AST from the cache
+void benchAstCache(size_t scale) {
+    std::string source = generateProgram(scale * 5);
+    char directory[] = "/tmp/gehu_bench_cacheXXXXXX";
+    if (!mkdtemp(directory)) {
+        std::fprintf(stderr, "cache: could not create a temporary directory\n");
+        return;
+    }
+    AstCache cache(directory);
+
+    FlatAst parsed;
+    Measurement parse = measure([&] {
+        StringInterner symbols;
+        std::vector<Token> tokens = tokenize(source, symbols);
+        Parser parser(tokens);
+        parsed = parser.parseFlat();
+        cache.store(source, symbols, parsed);
+    });
+    FlatAst loaded;
+    bool hit = false;
+    Measurement load = measure([&] {
+        StringInterner symbols;
+        hit = cache.load(source, symbols, loaded);
+    });
+    Measurement hash = measure([&] { AstCache::hash(source); });
+    if (!hit || loaded != parsed) {
+        std::fprintf(stderr, "cache: loaded AST differs from the parsed one\n");
+    }
+    std::remove(cache.path(source).c_str());
+    rmdir(directory);
+
+    report("cache/miss", "lex+parse+store", parse.seconds * 1e3, "ms");
+    report("cache/hit", "load", load.seconds * 1e3, "ms");
+    report("cache/hit", "of which hashing", hash.seconds * 1e3, "ms");
+    report("cache/hit", "speedup", parse.seconds / load.seconds, "x");
+}
+
+// Same source, diagnostics and top-level statement offsets
+bool sameFrontendState(IncrementalFrontend& a, IncrementalFrontend& b) {
+    if (a.text() != b.text() || a.diagnosticsTruncated() != b.diagnosticsTruncated() ||
+        a.getDiagnostics().size() != b.getDiagnostics().size() || !a.getProgram() != !b.getProgram()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.getDiagnostics().size(); ++i) {
+        const CompilerError& x = a.getDiagnostics()[i];
+        const CompilerError& y = b.getDiagnostics()[i];
+        if (x.getOffset() != y.getOffset() || std::string(x.what()) != y.what()) {
+            return false;
+        }
+    }
+    if (!a.getProgram()) {
+        return true;
+    }
+    const std::vector<Statement*>& left = a.getProgram()->statements;
+    const std::vector<Statement*>& right = b.getProgram()->statements;
+    if (left.size() != right.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < left.size(); ++i) {
+        if (left[i]->kind != right[i]->kind || left[i]->offset != right[i]->offset) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Edit-to-diagnostics latency of IncrementalFrontend on a file of about a
+// million lines at the default scale, against lexing, parsing and analyzing
+// the edited source from scratch
+void benchIncremental(size_t scale) {
+    std::unique_ptr<IncrementalFrontend> frontend;
+    Measurement build = measure([&] { frontend = std::make_unique<IncrementalFrontend>(generateProgram(scale * 3)); });
+    const std::string& text = frontend->text();
+    report("incremental", "lines", std::count(text.begin(), text.end(), '\n'), "");
+    report("incremental", "initial build", build.seconds * 1e3, "ms");
+
+    auto run = [&](const std::string& name, SourceEdit edit) {
+        Measurement m = measure([&] { frontend->edit({edit}); });
+        std::unique_ptr<IncrementalFrontend> fresh;
+        Measurement full = measure([&] { fresh = std::make_unique<IncrementalFrontend>(frontend->text()); });
+        report(name, "edit to diagnostics", m.seconds * 1e3, "ms");
+        report(name, "full rebuild", full.seconds * 1e3, "ms");
+        report(name, "statements reparsed", frontend->reparsedStatements(), "");
+        report(name, "statements reanalyzed", frontend->reanalyzedStatements(), "");
+        if (!sameFrontendState(*frontend, *fresh)) {
+            std::fprintf(stderr, "%s: incremental state differs from a full rebuild\n", name.c_str());
+        }
+    };
+    SourceOffset middle = static_cast<SourceOffset>(text.find(" * (3 + ", text.size() / 2) + 4);
+    run("incremental/same length", SourceEdit{middle, 1, "4"});
+    SourceOffset second = static_cast<SourceOffset>(text.find('\n') + 1);
+    run("incremental/insert at start", SourceEdit{second, 0, "let inserted = 1;\n"});
+    SourceOffset semicolon = static_cast<SourceOffset>(text.find(";\n", text.size() / 2));
+    run("incremental/break syntax", SourceEdit{semicolon, 1, ""});
+    run("incremental/fix syntax", SourceEdit{semicolon, 0, ";"});
+    SourceOffset last = static_cast<SourceOffset>(text.rfind("show "));
+    run("incremental/undeclared at end", SourceEdit{last, 5, "show undeclared + "});
+
+    // Edits inside the first token of a statement that turn it into or out of
+    // else, which decides whether the } before it ends a statement
+    auto check = [](const char* name, const std::string& source, const std::string& anchor, const std::string& from,
+                    const std::string& to) {
+        bool same;
+        {
+            QuietScope quiet;
+            IncrementalFrontend edited(source);
+            auto offset = static_cast<SourceOffset>(source.find(from, source.find(anchor)));
+            edited.edit({SourceEdit{offset, static_cast<SourceOffset>(from.size()), to}});
+            IncrementalFrontend fresh(edited.text());
+            same = sameFrontendState(edited, fresh);
+        }
+        if (!same) {
+            std::fprintf(stderr, "%s: incremental state differs from a full rebuild\n", name);
+        }
+    };
+    check("incremental/into else", "let elsex = 1;\nif (1 > 0) { show 1; } elsex = 2;\n", "} else", "x = 2;",
+          " { show 2; }");
+    check("incremental/out of else", "let a = 1;\nif (a > 0) { show a; } elseif (a > 1) // \"\nshow a;\n", "} else",
+          "if ", "\"");
+}
+
+// Lex + parse with a full token array versus pulling tokens on demand
+void benchStreamingParse(size_t scale) {
+    std::string source = generateProgram(scale);
+
+    Measurement array = measure([&] {
+        StringInterner symbols;
+        std::vector<Token> tokens = tokenize(source, symbols);
+        Parser parser(tokens);
+        parser.parse();
+    });
+    Measurement streaming = measure([&] {
+        StringInterner symbols;
+        Lexer lexer(source, symbols);
+        Parser parser(lexer);
+        parser.parse();
+    });
+    report("lex+parse/array", "time", array.seconds * 1e3, "ms");
+    report("lex+parse/array", "allocated", array.bytes / (1024.0 * 1024.0), "MiB");
+    report("lex+parse/stream", "time", streaming.seconds * 1e3, "ms");
+    report("lex+parse/stream", "allocated", streaming.bytes / (1024.0 * 1024.0), "MiB");
+}
+
+std::vector<lexer_simd::Isa> supportedIsas() {
+    std::vector<lexer_simd::Isa> isas;
+    for (lexer_simd::Isa isa : {lexer_simd::Isa::SCALAR, lexer_simd::Isa::SSE42,
+                                lexer_simd::Isa::AVX2, lexer_simd::Isa::AVX512}) {
+        if (lexer_simd::isSupported(isa)) {
+            isas.push_back(isa);
+        }
+    }
+    return isas;
+}
+
+// Peak throughput of each scanning kernel over one long run of its byte class
+void benchLexerKernels(size_t) {
+    const size_t size = 64 * 1024 * 1024;
+    auto fill = [&](const std::string& pattern, char terminator) {
+        std::string buffer;
+        buffer.reserve(size + 1);
+        while (buffer.size() < size) {
+            buffer += pattern;
+        }
+        buffer.resize(size);
+        buffer += terminator;
+        return buffer;
+    };
+    const std::string whitespace = fill("    \t  \n", ';');
+    const std::string identifier = fill("some_Name42", ';');
+    const std::string digits = fill("0123456789", ';');
+    const std::string text = fill("string body with\nnewlines ", '"');
+    const std::string comment = fill("comment text ", '\n');
+
+    for (lexer_simd::Isa isa : supportedIsas()) {
+        const lexer_simd::Kernels& k = lexer_simd::kernelsFor(isa);
+        std::string name = std::string("kernel/") + lexer_simd::isaName(isa);
+        auto run = [&](const char* kernel, const std::string& input, auto&& scan) {
+            const int repeats = 4;
+            const char* stop = nullptr;
+            Measurement m = measure([&] {
+                for (int i = 0; i < repeats; ++i) {
+                    stop = scan(input.data(), input.data() + input.size());
+                }
+            });
+            if (stop != input.data() + size) {
+                std::fprintf(stderr, "%s %s stopped at the wrong byte\n", name.c_str(), kernel);
+            }
+            report(name, kernel, repeats * size / m.seconds / 1e9, "GB/s");
+        };
+        run("whitespace", whitespace, [&](const char* p, const char* e) { return k.skipWhitespace(p, e); });
+        run("identifier", identifier, [&](const char* p, const char* e) { return k.skipIdentifier(p, e); });
+        run("digits", digits, [&](const char* p, const char* e) { return k.skipDigits(p, e); });
+        run("string", text, [&](const char* p, const char* e) { return k.findQuote(p, e); });
+        run("comment", comment, [&](const char* p, const char* e) { return k.findNewline(p, e); });
+        run("quote/slash", text, [&](const char* p, const char* e) { return k.findQuoteOrSlash(p, e); });
+    }
+}
+
+bool sameTokens(const std::vector<Token>& a, const std::vector<Token>& b) {
+    bool same = a.size() == b.size();
+    for (size_t i = 0; same && i < a.size(); ++i) {
+        same = a[i].type == b[i].type && a[i].value == b[i].value && a[i].symbol == b[i].symbol &&
+               a[i].offset == b[i].offset;
+    }
+    return same;
+}
+
+// End-to-end Lexer::nextToken throughput under each kernel set
+void benchLex(size_t scale) {
+    std::string source = generateProgram(scale);
+    std::vector<Token> reference;
+    for (lexer_simd::Isa isa : supportedIsas()) {
+        lexer_simd::selectIsa(isa);
+        std::vector<Token> tokens;
+        StringInterner symbols;
+        Measurement m = measure([&] { tokens = tokenize(source, symbols); });
+        std::string name = std::string("lex/") + lexer_simd::isaName(isa);
+        report(name, "throughput", source.size() / m.seconds / 1e6, "MB/s");
+        report(name, "ns/token", m.seconds * 1e9 / tokens.size(), "ns");
+
+        if (reference.empty()) {
+            reference = tokens;
+        } else if (!sameTokens(tokens, reference)) {
+            std::fprintf(stderr, "%s token stream differs from scalar\n", name.c_str());
+        }
+    }
+    lexer_simd::selectIsa(lexer_simd::detectIsa());
+}
+
+// Lexing with the per-token trace off, compiled out or not, and on, written
+// to /dev/null by the lexing thread and by the writer thread
+void benchLogging(size_t scale) {
+    std::string source = generateProgram(scale);
+    if (!logging::openFile("/dev/null")) {
+        std::fprintf(stderr, "log: could not open /dev/null\n");
+        return;
+    }
+    auto run = [&](const char* name, const char* spec, bool async) {
+        logging::configure(spec);
+        logging::setAsync(async);
+        StringInterner symbols;
+        std::vector<Token> tokens;
+        Measurement m = measure([&] {
+            tokens = tokenize(source, symbols);
+            logging::flush();
+        });
+        report(name, "ns/token", m.seconds * 1e9 / tokens.size(), "ns");
+    };
+    run("log/off", "off", false);
+    run("log/lexer trace", "lexer", false);
+    run("log/lexer trace async", "lexer", true);
+    logging::configure("off");
+    logging::setAsync(false);
+}
+
+// ParallelLexer throughput by thread count; the speedup is bounded by the
+// cores available (printed first)
+void benchParallelLex(size_t scale) {
+    std::string source = generateProgram(scale * 5);
+    std::vector<Token> reference;
+    {
+        StringInterner symbols;
+        reference = tokenize(source, symbols);
+    }
+    report("lex/parallel", "hardware threads", std::thread::hardware_concurrency(), "");
+    double serial = 0;
+    for (unsigned threads : {1u, 2u, 4u, 8u}) {
+        std::vector<Token> tokens;
+        StringInterner symbols;
+        ParallelLexer lexer(source, symbols);
+        lexer.setThreadCount(threads);
+        Measurement m = measure([&] { tokens = lexer.tokenize(); });
+        if (threads == 1) {
+            serial = m.seconds;
+        }
+        std::string name = "lex/parallel/" + std::to_string(threads);
+        report(name, "throughput", source.size() / m.seconds / 1e6, "MB/s");
+        report(name, "speedup", serial / m.seconds, "x");
+        if (!sameTokens(tokens, reference)) {
+            std::fprintf(stderr, "%s token stream differs from the serial lexer\n", name.c_str());
+        }
+    }
+}
+
+// Peak resident set size of the whole process so far
+double peakRssMiB() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0;
+}
+
+// Current resident set size
+double currentRssMiB() {
+    long pages = 0, resident = 0;
+    if (FILE* statm = std::fopen("/proc/self/statm", "r")) {
+        if (std::fscanf(statm, "%ld %ld", &pages, &resident) != 2) {
+            resident = 0;
+        }
+        std::fclose(statm);
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024.0) / 1024.0;
+}
+
+// AST build and teardown cost; run it alone (--filter=ast) for a meaningful peak RSS
+void benchAstLifetime(size_t scale) {
+    std::string source = generateProgram(scale * 5);
+    StringInterner symbols;
+    std::vector<Token> tokens = tokenize(source, symbols);
+    double rssBefore = currentRssMiB();
+
+    std::unique_ptr<Program> program;
+    Measurement parse = measure([&] {
+        Parser parser(tokens);
+        program = parser.parse();
+    });
+    double rssAfter = currentRssMiB();
+    Measurement destroy = measure([&] { program.reset(); });
+
+    report("ast", "statements", static_cast<double>(scale * 5), "");
+    report("ast", "parse time", parse.seconds * 1e3, "ms");
+    report("ast", "parse allocations", static_cast<double>(parse.allocations), "");
+    report("ast", "destroy time", destroy.seconds * 1e3, "ms");
+    report("ast", "resident AST", rssAfter - rssBefore, "MiB");
+    report("ast", "peak RSS", peakRssMiB(), "MiB");
+}
+
+// Pointer tree against the flat index-based AST: build, walk and memory.
+// The input has no blocks, whose scope copies would swamp the walk itself;
+// codegen is dominated by LLVM, so it runs on a tenth of the input
+void benchFlatAst(size_t scale) {
+    std::string source = generateProgram(scale * 5, false);
+    StringInterner symbols;
+    std::vector<Token> tokens = tokenize(source, symbols);
+
+    std::unique_ptr<Program> program;
+    FlatAst flat;
+    Measurement treeParse = measure([&] {
+        Parser parser(tokens);
+        program = parser.parse();
+    });
+    Measurement flatParse = measure([&] {
+        Parser parser(tokens);
+        flat = parser.parseFlat();
+    });
+
+    // Best of a few runs: sema is fast enough for timer noise to matter
+    double treeSema = 1e9, flatSema = 1e9;
+    for (int run = 0; run < 5; ++run) {
+        SemanticAnalyzer analyzer(symbols);
+        treeSema = std::min(treeSema, measure([&] { analyzer.analyze(program.get()); }).seconds);
+        flatSema = std::min(flatSema, measure([&] { analyzer.analyze(flat); }).seconds);
+    }
+
+    std::string smallSource = generateProgram(scale / 2, false);
+    StringInterner smallSymbols;
+    std::vector<Token> smallTokens = tokenize(smallSource, smallSymbols);
+    std::unique_ptr<Program> smallProgram;
+    FlatAst smallFlat;
+    {
+        QuietScope quiet;
+        smallProgram = Parser(smallTokens).parse();
+        smallFlat = Parser(smallTokens).parseFlat();
+    }
+    Measurement treeCodegen = measure([&] {
+        CodeGenerator codegen(smallSymbols);
+        codegen.generate(smallProgram.get());
+    });
+    Measurement flatCodegen = measure([&] {
+        CodeGenerator codegen(smallSymbols);
+        codegen.generate(smallFlat);
+    });
+
+    report("ast/tree", "parse time", treeParse.seconds * 1e3, "ms");
+    report("ast/tree", "parse allocations", static_cast<double>(treeParse.allocations), "");
+    report("ast/tree", "sema time", treeSema * 1e3, "ms");
+    report("ast/tree", "codegen time", treeCodegen.seconds * 1e3, "ms");
+    report("ast/tree", "memory", program->arena.bytesReserved() / (1024.0 * 1024.0), "MiB");
+    report("ast/flat", "parse time", flatParse.seconds * 1e3, "ms");
+    report("ast/flat", "parse allocations", static_cast<double>(flatParse.allocations), "");
+    report("ast/flat", "sema time", flatSema * 1e3, "ms");
+    report("ast/flat", "codegen time", flatCodegen.seconds * 1e3, "ms");
+    report("ast/flat", "memory", flat.memoryUsage() / (1024.0 * 1024.0), "MiB");
+}
+
+// Per-node cost of walking the pointer tree with the semantic analyzer
+void benchVisit(size_t scale) {
+    std::string source = generateProgram(scale * 5, false);
+    StringInterner symbols;
+    std::vector<Token> tokens = tokenize(source, symbols);
+    std::unique_ptr<Program> program;
+    size_t nodes = 0;
+    {
+        QuietScope quiet;
+        program = Parser(tokens).parse();
+        nodes = Parser(tokens).parseFlat().size();
+    }
+
+    double best = 1e9;
+    for (int run = 0; run < 5; ++run) {
+        SemanticAnalyzer analyzer(symbols);
+        best = std::min(best, measure([&] { analyzer.analyze(program.get()); }).seconds);
+    }
+    report("visit/sema", "nodes", static_cast<double>(nodes), "");
+    report("visit/sema", "time", best * 1e3, "ms");
+    report("visit/sema", "ns/node", best * 1e9 / nodes, "ns");
+}
+
+// `variables` top-level declarations, then if blocks nested `depth` deep,
+// each declaring one variable and reading an outer one
+std::string generateNestedProgram(size_t variables, size_t depth) {
+    std::string out;
+    for (size_t i = 0; i < variables; ++i) {
+        out += "let g" + std::to_string(i) + " = " + std::to_string(i) + ";\n";
+    }
+    for (size_t i = 0; i < depth; ++i) {
+        out += "if (g" + std::to_string(i % variables) + " < 10) {\nlet n" + std::to_string(i) + " = g" +
+               std::to_string((i * 7) % variables) + " + 1;\n";
+    }
+    out += "show g0;\n";
+    for (size_t i = 0; i < depth; ++i) {
+        out += "}\n";
+    }
+    return out;
+}
+
+// Semantic analysis of deeply nested scopes under many variables, and of
+// many sibling blocks; cost should follow the declarations, not their product
+void benchScopes(size_t scale) {
+    struct Shape {
+        size_t variables;
+        size_t depth;
+    };
+    for (Shape shape : {Shape{1000, 1000}, Shape{4000, 4000}, Shape{std::max<size_t>(scale / 20, 1), 4000}}) {
+        std::string source = generateNestedProgram(shape.variables, shape.depth);
+        StringInterner symbols;
+        std::vector<Token> tokens = tokenize(source, symbols);
+        std::unique_ptr<Program> program;
+        {
+            QuietScope quiet;
+            program = Parser(tokens).parse();
+        }
+        SemanticAnalyzer analyzer(symbols);
+        Measurement m = measure([&] { analyzer.analyze(program.get()); });
+        std::string name = "scopes/" + std::to_string(shape.variables) + "x" + std::to_string(shape.depth);
+        report(name, "sema time", m.seconds * 1e3, "ms");
+        report(name, "allocated", m.bytes / (1024.0 * 1024.0), "MiB");
+    }
+
+    std::string source = generateProgram(scale);
+    StringInterner symbols;
+    std::vector<Token> tokens = tokenize(source, symbols);
+    std::unique_ptr<Program> program;
+    {
+        QuietScope quiet;
+        program = Parser(tokens).parse();
+    }
+    SemanticAnalyzer analyzer(symbols);
+    Measurement m = measure([&] { analyzer.analyze(program.get()); });
+    report("scopes/siblings", "blocks", static_cast<double>(scale / 5 * 2), "");
+    report("scopes/siblings", "sema time", m.seconds * 1e3, "ms");
+    report("scopes/siblings", "allocated", m.bytes / (1024.0 * 1024.0), "MiB");
+}
+
+// `depth` nested if blocks, `depth` nested parentheses, or a right-deep
+// chain of `depth` additions
+std::string generateDeepProgram(const std::string& shape, size_t depth) {
+    std::string out = "let x = 1;\n";
+    if (shape == "ifs") {
+        for (size_t i = 0; i < depth; ++i) {
+            out += "if (x < 10) {\n";
+        }
+        out += "x = x + 1;\n";
+        out.append(depth, '}');
+        out += "\n";
+    } else if (shape == "parens") {
+        out += "x = ";
+        out.append(depth, '(');
+        out += "x";
+        out.append(depth, ')');
+        out += ";\n";
+    } else {
+        out += "x = ";
+        for (size_t i = 0; i < depth; ++i) {
+            out += "x + (";
+        }
+        out += "1";
+        out.append(depth, ')');
+        out += ";\n";
+    }
+    out += "show x;\n";
+    return out;
+}
+
+// Parse, analysis and code generation of pathologically deep nesting; each
+// doubling of the depth should roughly double the time
+void benchNesting(size_t) {
+    for (const char* shape : {"ifs", "parens", "chain"}) {
+        for (size_t depth : {25000, 50000, 100000}) {
+            std::string source = generateDeepProgram(shape, depth);
+            StringInterner symbols;
+            std::vector<Token> tokens = tokenize(source, symbols);
+            std::string name = std::string("nesting/") + shape + "/" + std::to_string(depth);
+
+            std::unique_ptr<Program> program;
+            FlatAst flat;
+            double treeParse = measure([&] { program = Parser(tokens).parse(); }).seconds;
+            double flatParse = measure([&] { flat = Parser(tokens).parseFlat(); }).seconds;
+            SemanticAnalyzer treeAnalyzer(symbols);
+            double treeSema = measure([&] { treeAnalyzer.analyze(program.get()); }).seconds;
+            SemanticAnalyzer flatAnalyzer(symbols);
+            double flatSema = measure([&] { flatAnalyzer.analyze(flat); }).seconds;
+            double treeCodegen = measure([&] { CodeGenerator(symbols).generate(program.get()); }).seconds;
+            double flatCodegen = measure([&] { CodeGenerator(symbols).generate(flat); }).seconds;
+
+            report(name, "tree parse", treeParse * 1e3, "ms");
+            report(name, "flat parse", flatParse * 1e3, "ms");
+            report(name, "tree sema", treeSema * 1e3, "ms");
+            report(name, "flat sema", flatSema * 1e3, "ms");
+            report(name, "tree codegen", treeCodegen * 1e3, "ms");
+            report(name, "flat codegen", flatCodegen * 1e3, "ms");
+        }
+    }
+}
+
+std::string corpusDirectory = GEHU_CORPUS_DIR;
+
+struct PipelineInput {
+    std::string name;
+    std::string source;
+};
+
+// Every .gehu file of the corpus, by file name
+std::vector<PipelineInput> corpusInputs() {
+    std::vector<std::filesystem::path> paths;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(corpusDirectory, error)) {
+        if (entry.path().extension() == ".gehu") {
+            paths.push_back(entry.path());
+        }
+    }
+    if (error) {
+        std::fprintf(stderr, "pipeline: could not read corpus %s: %s\n", corpusDirectory.c_str(), error.message().c_str());
+    }
+    std::sort(paths.begin(), paths.end());
+    std::vector<PipelineInput> inputs;
+    for (const std::filesystem::path& path : paths) {
+        std::ifstream in(path, std::ios::binary);
+        std::string source((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        inputs.push_back(PipelineInput{path.stem().string(), std::move(source)});
+    }
+    return inputs;
+}
+
+// Each stage of the driver's pipeline on one input, timed on its own. The
+// whole pipeline repeats until it has run for 0.2 s (at least 3 times,
+// at most 1000) and each stage reports its mean
+void benchPipelineInput(const PipelineInput& input) {
+    enum Stage { LEX, PARSE, SEMA, GENERATE, VERIFY, RUN, STAGES };
+    static const char* const stageNames[] = {"lex", "parse", "sema", "generate", "verify", "run"};
+    double seconds[STAGES] = {};
+    double total = 0;
+    size_t repetitions = 0;
+    uint64_t nodes = 0;
+    uint64_t statements = 0;
+    try {
+        QuietScope quiet;
+        auto time = [&](Stage stage, const auto& body) {
+            auto start = std::chrono::steady_clock::now();
+            body();
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            seconds[stage] += elapsed;
+            total += elapsed;
+        };
+        while (repetitions < 3 || (total < 0.2 && repetitions < 1000)) {
+            StringInterner symbols;
+            std::vector<Token> tokens;
+            time(LEX, [&] {
+                Lexer lexer(input.source, symbols);
+                Token token;
+                do {
+                    token = lexer.nextToken();
+                    tokens.push_back(token);
+                } while (token.type != TokenType::EOF_TOKEN);
+            });
+            std::unique_ptr<Program> program;
+            time(PARSE, [&] { program = Parser(tokens).parse(); });
+            time(SEMA, [&] {
+                SemanticAnalyzer analyzer(symbols);
+                analyzer.analyze(program.get());
+            });
+            CodeGenerator codegen(symbols);
+            time(GENERATE, [&] { codegen.generate(program.get()); });
+            time(VERIFY, [&] { codegen.verify(); });
+            time(RUN, [&] { codegen.run(); });
+            if (repetitions++ == 0) {
+                Stats stats;
+                stats.countNodes(*program);
+                for (size_t kind = 0; kind < Stats::kNodeKinds; ++kind) {
+                    nodes += stats.counters.nodes[kind];
+                    // Blocks only group the statements they hold
+                    if (kind >= static_cast<size_t>(NodeKind::IF_STATEMENT)) {
+                        statements += stats.counters.nodes[kind];
+                    }
+                }
+            }
+        }
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "pipeline/%s: %s\n", input.name.c_str(), e.what());
+        return;
+    }
+
+    std::string name = "pipeline/" + input.name;
+    double statementCount = static_cast<double>(std::max<uint64_t>(statements, 1));
+    report(name, "statements", static_cast<double>(statements), "");
+    report(name, "nodes", static_cast<double>(nodes), "");
+    for (size_t stage = 0; stage < STAGES; ++stage) {
+        double mean = seconds[stage] / repetitions;
+        std::string stageName = stageNames[stage];
+        if (stage == LEX) {
+            report(name, stageName + " throughput", input.source.size() / mean / 1e6, "MB/s");
+        } else if (stage <= GENERATE) {
+            report(name, stageName + " throughput", nodes / mean / 1e6, "Mnodes/s");
+        }
+        report(name, stageName + " ns/statement", mean * 1e9 / statementCount, "ns");
+    }
+    report(name, "total throughput", input.source.size() / (total / repetitions) / 1e6, "MB/s");
+    report(name, "total ns/statement", total / repetitions * 1e9 / statementCount, "ns");
+}
+
+// The pipeline stages on the corpus and on synthetic programs of three
+// sizes, in a scratch directory since verification writes output.ll
+void benchPipeline(size_t scale) {
+    std::vector<PipelineInput> inputs = corpusInputs();
+    for (size_t statements : {scale / 1000, scale / 100, scale / 10}) {
+        statements = std::max<size_t>(statements, 1);
+        inputs.push_back(PipelineInput{"synthetic-" + std::to_string(statements), generateProgram(statements)});
+    }
+
+    char directory[] = "/tmp/gehu_bench_pipelineXXXXXX";
+    std::error_code error;
+    std::filesystem::path previous = std::filesystem::current_path(error);
+    if (error || !mkdtemp(directory) || chdir(directory) != 0) {
+        std::fprintf(stderr, "pipeline: could not enter a temporary directory\n");
+        return;
+    }
+    for (const PipelineInput& input : inputs) {
+        benchPipelineInput(input);
+    }
+    std::filesystem::current_path(previous, error);
+    std::filesystem::remove_all(directory, error);
+}
+
+// Compile time against run time at each -O level: the pass pipeline, JIT
+// compilation and the best of 5 runs of the compiled program
+void benchOptLevels(size_t scale) {
+    static const std::pair<CodeGenerator::OptLevel, const char*> levels[] = {
+        {CodeGenerator::OptLevel::O0, "O0"}, {CodeGenerator::OptLevel::O1, "O1"}, {CodeGenerator::OptLevel::O2, "O2"},
+        {CodeGenerator::OptLevel::O3, "O3"}, {CodeGenerator::OptLevel::OS, "Os"},
+    };
+    std::string source = generateProgram(std::max<size_t>(scale / 10, 1));
+    StringInterner symbols;
+    std::vector<Token> tokens = tokenize(source, symbols);
+    std::unique_ptr<Program> program;
+    {
+        QuietScope quiet;
+        program = Parser(tokens).parse();
+    }
+
+    for (const auto& [level, levelName] : levels) {
+        CodeGenerator codegen(symbols);
+        codegen.setOptLevel(level);
+        Measurement optimize, jit;
+        double execute = 1e9;
+        try {
+            measure([&] { codegen.generate(program.get()); });
+            optimize = measure([&] { codegen.optimize(); });
+            jit = measure([&] { codegen.prepare(); });
+            for (int run = 0; run < 5; ++run) {
+                execute = std::min(execute, measure([&] { codegen.execute(); }).seconds);
+            }
+        } catch (const std::exception& e) {
+            std::fprintf(stderr, "opt/%s: %s\n", levelName, e.what());
+            continue;
+        }
+        std::string name = std::string("opt/") + levelName;
+        report(name, "optimize", optimize.seconds * 1e3, "ms");
+        report(name, "jit", jit.seconds * 1e3, "ms");
+        report(name, "compile total", (optimize.seconds + jit.seconds) * 1e3, "ms");
+        report(name, "execute", execute * 1e3, "ms");
+        report(name, "machine code", codegen.machineCodeBytes() / 1024.0, "KiB");
+    }
+}
+
+struct Benchmark {
+    const char* name;
+    void (*run)(size_t scale);
+};
+
+const Benchmark benchmarks[] = {
+    {"kernels", benchLexerKernels},
+    {"lex", benchLex},
+    {"plex", benchParallelLex},
+    {"log", benchLogging},
+    {"parse", benchParse},
+    {"pparse", benchParallelParse},
+    {"expr", benchExpressions},
+    {"stream", benchStreamingParse},
+    {"cache", benchAstCache},
+    {"incremental", benchIncremental},
+    {"ast", benchAstLifetime},
+    {"flat", benchFlatAst},
+    {"visit", benchVisit},
+    {"scopes", benchScopes},
+    {"nesting", benchNesting},
+    {"pipeline", benchPipeline},
+    {"opt", benchOptLevels},
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string filter;
+    size_t scale = 200000;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--filter=", 0) == 0) {
+            filter = arg.substr(9);
+        } else if (arg.rfind("--scale=", 0) == 0) {
+            scale = std::stoul(arg.substr(8));
+        } else if (arg.rfind("--corpus=", 0) == 0) {
+            corpusDirectory = arg.substr(9);
+        } else if (arg == "--json") {
+            jsonOutput = true;
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--filter=<substring>] [--scale=<statements>] [--corpus=<dir>] [--json]" << std::endl;
+            return 1;
+        }
+    }
+
+    for (const Benchmark& benchmark : benchmarks) {
+        if (filter.empty() || std::string(benchmark.name).find(filter) != std::string::npos) {
+            benchmark.run(scale);
+        }
+    }
+    if (jsonOutput) {
+        printJson(scale);
+    }
+    return 0;
+}
@@ -0,0 +1,22 @@
+# Writes OUTPUT, a header defining GEHU_BUILD_ID as a hash of every source
+# under SOURCE_DIR/src. AstCache stamps its entries with it, so a change to
+# any of them retires what older builds cached. The header is only rewritten
+# when the id changes, so an unchanged tree recompiles nothing
+file(GLOB sources "${SOURCE_DIR}/src/*.cpp" "${SOURCE_DIR}/src/*.hpp")
+list(SORT sources)
+set(hashes "")
+foreach(source ${sources})
+    file(SHA256 "${source}" hash)
+    get_filename_component(name "${source}" NAME)
+    string(APPEND hashes "${name} ${hash}\n")
+endforeach()
+string(SHA256 id "${hashes}")
+string(SUBSTRING "${id}" 0 16 id)
+
+set(content "// Generated by cmake/build_id.cmake; do not edit\n#define GEHU_BUILD_ID \"${id}\"\n")
+if(EXISTS "${OUTPUT}")
+    file(READ "${OUTPUT}" previous)
+endif()
+if(NOT previous STREQUAL content)
+    file(WRITE "${OUTPUT}" "${content}")
+endif()
@@ -0,0 +1,117 @@
+//
+//Arena class definition
+//Arena is a bump allocator that hands out memory from large chunks
+//Objects in an arena are never destroyed one by one: the chunks are freed
+//together when the arena goes away, so only trivially destructible types
+//may live in it
+//ArenaSpan is a fixed-size array allocated in an arena
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+template <typename T>
+class ArenaSpan {
+public:
+    ArenaSpan() = default;
+    ArenaSpan(T* items, size_t count) : items(items), count(count) {}
+
+    T* begin() const { return items; }
+    T* end() const { return items + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T& operator[](size_t i) const { return items[i]; }
+
+private:
+    T* items = nullptr;
+    size_t count = 0;
+};
+
+class Arena {
+public:
+    static constexpr size_t kFirstChunkSize = 64 * 1024;
+    static constexpr size_t kMaxChunkSize = 4 * 1024 * 1024;
+
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    Arena(Arena&&) = default;
+    Arena& operator=(Arena&&) = default;
+
+    void* allocate(size_t size, size_t alignment) {
+        size_t padding = (alignment - reinterpret_cast<uintptr_t>(cursor) % alignment) % alignment;
+        if (size + padding > remaining) {
+            grow(size + alignment);
+            padding = (alignment - reinterpret_cast<uintptr_t>(cursor) % alignment) % alignment;
+        }
+        char* result = cursor + padding;
+        cursor = result + size;
+        remaining -= size + padding;
+        return result;
+    }
+
+    template <typename T, typename... Args>
+    T* make(Args&&... args) {
+        static_assert(std::is_trivially_destructible<T>::value, "arena objects are never destroyed");
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    ArenaSpan<T> copyArray(const T* items, size_t count) {
+        static_assert(std::is_trivially_copyable<T>::value, "arena arrays are copied bytewise");
+        if (count == 0) {
+            return ArenaSpan<T>();
+        }
+        T* data = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+        std::memcpy(data, items, sizeof(T) * count);
+        return ArenaSpan<T>(data, count);
+    }
+
+    std::string_view copyString(std::string_view text) {
+        if (text.empty()) {
+            return std::string_view();
+        }
+        char* data = static_cast<char*>(allocate(text.size(), 1));
+        std::memcpy(data, text.data(), text.size());
+        return std::string_view(data, text.size());
+    }
+
+    // Takes over other's chunks, so what was allocated there lives as long as
+    // this arena; other is left empty
+    void adopt(Arena&& other) {
+        for (std::unique_ptr<char[]>& chunk : other.chunks) {
+            chunks.push_back(std::move(chunk));
+        }
+        reserved += other.reserved;
+        other = Arena();
+    }
+
+    // Bytes obtained from the system, including unused chunk tails
+    size_t bytesReserved() const { return reserved; }
+    size_t chunkCount() const { return chunks.size(); }
+
+private:
+    std::vector<std::unique_ptr<char[]>> chunks;
+    char* cursor = nullptr;
+    size_t remaining = 0;
+    size_t nextChunkSize = kFirstChunkSize;
+    size_t reserved = 0;
+
+    void grow(size_t minimum) {
+        size_t size = nextChunkSize < minimum ? minimum : nextChunkSize;
+        chunks.emplace_back(new char[size]);
+        cursor = chunks.back().get();
+        remaining = size;
+        reserved += size;
+        if (nextChunkSize < kMaxChunkSize) {
+            nextChunkSize *= 2;
+        }
+    }
+};
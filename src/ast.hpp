@@ -1,10 +1,21 @@
+//
+//AST node definitions
+//Nodes are allocated in the Program's Arena and freed all at once with it,
+//so they are trivially destructible: children are plain pointers, lists are
+//ArenaSpans and string literal text is copied into the arena
+//Every node records the byte offset it starts at (for binary expressions,
+//the operator; for declarations and assignments, the variable name)
+//Every node carries a NodeKind tag; visitors switch on it (see ast_visitor.hpp)
+//and nodeCast checks it, so nodes need neither a vtable nor RTTI
 #pragma once
 
+#include "arena.hpp"
 #include "ast_forward.hpp"
-#include "ast_visitor.hpp"
+#include "interner.hpp"
+#include "source_location.hpp"
+#include <cstdint>
+#include <string_view>
 #include <vector>
-#include <memory>
-#include <string>
 
 enum class BinaryOperator {
     ADD,
@@ -19,110 +30,118 @@ enum class BinaryOperator {
     NOT_EQUAL
 };
 
+enum class NodeKind : uint8_t {
+    STRING_LITERAL,
+    NUMBER_LITERAL,
+    IDENTIFIER,
+    BINARY_EXPRESSION,
+    BLOCK,
+    IF_STATEMENT,
+    VARIABLE_DECLARATION,
+    SHOW_STATEMENT,
+    ASSIGNMENT_STATEMENT
+};
+
 class Expression {
 public:
-    virtual ~Expression() = default;
-    virtual void accept(ASTVisitor& visitor) = 0;
+    const NodeKind kind;
+    SourceOffset offset;
+protected:
+    Expression(NodeKind kind, SourceOffset offset) : kind(kind), offset(offset) {}
+    ~Expression() = default; // never deleted through the base; the arena frees it
 };
 
 class Statement {
 public:
-    virtual ~Statement() = default;
-    virtual void accept(ASTVisitor& visitor) = 0;
+    const NodeKind kind;
+    SourceOffset offset;
+protected:
+    Statement(NodeKind kind, SourceOffset offset) : kind(kind), offset(offset) {}
+    ~Statement() = default;
 };
 
 class StringLiteral : public Expression {
 public:
-    std::string value;
-    StringLiteral(const std::string& value) : value(value) {}
-    void accept(ASTVisitor& visitor) override {
-        visitor.visitStringLiteral(this);
-    }
+    static constexpr NodeKind kKind = NodeKind::STRING_LITERAL;
+    std::string_view value; // arena copy of the literal text
+    StringLiteral(std::string_view value, SourceOffset offset) : Expression(kKind, offset), value(value) {}
 };
 
 class NumberLiteral : public Expression {
 public:
+    static constexpr NodeKind kKind = NodeKind::NUMBER_LITERAL;
     int value;
-    NumberLiteral(int value) : value(value) {}
-    void accept(ASTVisitor& visitor) override {
-        visitor.visitNumberLiteral(this);
-    }
+    NumberLiteral(int value, SourceOffset offset) : Expression(kKind, offset), value(value) {}
 };
 
 class Identifier : public Expression {
 public:
-    std::string name;
-    Identifier(const std::string& name) : name(name) {}
-    void accept(ASTVisitor& visitor) override {
-        visitor.visitIdentifier(this);
-    }
+    static constexpr NodeKind kKind = NodeKind::IDENTIFIER;
+    SymbolId name;
+    Identifier(SymbolId name, SourceOffset offset) : Expression(kKind, offset), name(name) {}
 };
 
 class BinaryExpression : public Expression {
 public:
-    std::unique_ptr<Expression> left;
+    static constexpr NodeKind kKind = NodeKind::BINARY_EXPRESSION;
+    Expression* left;
     BinaryOperator op;
-    std::unique_ptr<Expression> right;
-    BinaryExpression(std::unique_ptr<Expression> left, BinaryOperator op, std::unique_ptr<Expression> right)
-        : left(std::move(left)), op(op), right(std::move(right)) {}
-    void accept(ASTVisitor& visitor) override {
-        visitor.visitBinaryExpression(this);
-    }
+    Expression* right;
+    BinaryExpression(Expression* left, BinaryOperator op, Expression* right, SourceOffset offset)
+        : Expression(kKind, offset), left(left), op(op), right(right) {}
 };
 
 class Block : public Statement {
 public:
-    std::vector<std::unique_ptr<Statement>> statements;
-    Block(std::vector<std::unique_ptr<Statement>> statements) : statements(std::move(statements)) {}
-    void accept(ASTVisitor& visitor) override {
-        visitor.visitBlock(this);
-    }
+    static constexpr NodeKind kKind = NodeKind::BLOCK;
+    ArenaSpan<Statement*> statements;
+    Block(ArenaSpan<Statement*> statements, SourceOffset offset) : Statement(kKind, offset), statements(statements) {}
 };
 
 class IfStatement : public Statement {
 public:
-    std::unique_ptr<Expression> condition;
-    std::unique_ptr<Block> thenBlock;
-    std::unique_ptr<Block> elseBlock;
-    IfStatement(std::unique_ptr<Expression> condition, std::unique_ptr<Block> thenBlock, std::unique_ptr<Block> elseBlock)
-        : condition(std::move(condition)), thenBlock(std::move(thenBlock)), elseBlock(std::move(elseBlock)) {}
-    void accept(ASTVisitor& visitor) override {
-        visitor.visitIfStatement(this);
-    }
+    static constexpr NodeKind kKind = NodeKind::IF_STATEMENT;
+    Expression* condition;
+    Block* thenBlock;
+    Block* elseBlock; // null when there is no else
+    IfStatement(Expression* condition, Block* thenBlock, Block* elseBlock, SourceOffset offset)
+        : Statement(kKind, offset), condition(condition), thenBlock(thenBlock), elseBlock(elseBlock) {}
 };
 
 class VariableDeclaration : public Statement {
 public:
-    std::string name;
-    std::unique_ptr<Expression> value;
-    VariableDeclaration(const std::string& name, std::unique_ptr<Expression> value)
-        : name(name), value(std::move(value)) {}
-    void accept(ASTVisitor& visitor) override {
-        visitor.visitVariableDeclaration(this);
-    }
+    static constexpr NodeKind kKind = NodeKind::VARIABLE_DECLARATION;
+    SymbolId name;
+    Expression* value;
+    VariableDeclaration(SymbolId name, Expression* value, SourceOffset offset)
+        : Statement(kKind, offset), name(name), value(value) {}
 };
 
 class ShowStatement : public Statement {
 public:
-    std::unique_ptr<Expression> expression;
-    ShowStatement(std::unique_ptr<Expression> expression) : expression(std::move(expression)) {}
-    void accept(ASTVisitor& visitor) override {
-        visitor.visitShowStatement(this);
-    }
+    static constexpr NodeKind kKind = NodeKind::SHOW_STATEMENT;
+    Expression* expression;
+    ShowStatement(Expression* expression, SourceOffset offset) : Statement(kKind, offset), expression(expression) {}
 };
 
 class AssignmentStatement : public Statement {
 public:
-    std::string name;
-    std::unique_ptr<Expression> value;
-    AssignmentStatement(const std::string& name, std::unique_ptr<Expression> value)
-        : name(name), value(std::move(value)) {}
-    void accept(ASTVisitor& visitor) override {
-        visitor.visitAssignmentStatement(this);
-    }
+    static constexpr NodeKind kKind = NodeKind::ASSIGNMENT_STATEMENT;
+    SymbolId name;
+    Expression* value;
+    AssignmentStatement(SymbolId name, Expression* value, SourceOffset offset)
+        : Statement(kKind, offset), name(name), value(value) {}
 };
 
+//Downcast that checks the kind tag; null when node is not a T
+template <typename T, typename Base>
+T* nodeCast(Base* node) {
+    return node->kind == T::kKind ? static_cast<T*>(node) : nullptr;
+}
+
+//Program owns the arena that every node of its tree lives in
 class Program {
 public:
-    std::vector<std::unique_ptr<Statement>> statements;
+    Arena arena;
+    std::vector<Statement*> statements;
 }; 
\ No newline at end of file
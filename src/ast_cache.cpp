@@ -0,0 +1,448 @@
+#include "ast_cache.hpp"
+#include "gehu_build_id.h" //GEHU_BUILD_ID, from cmake/build_id.cmake
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include <fcntl.h> //for open
+#include <sys/mman.h> //for mmap, munmap
+#include <sys/stat.h> //for fstat, mkdir
+#include <unistd.h> //for close, getpid
+
+namespace {
+
+//Bump the format number whenever the layout below or the FlatAst changes.
+//GEHU_BUILD_ID hashes every compiler source, so entries written by a build
+//with any other parser are retired too, in an incremental build as well
+constexpr const char* kCompilerVersion = "gehu-ast-1 " GEHU_BUILD_ID;
+constexpr char kMagic[8] = {'G', 'E', 'H', 'U', 'A', 'S', 'T', '\0'};
+constexpr size_t kAlignment = 8;
+
+struct Header {
+    char magic[8];
+    uint64_t compilerHash;
+    uint64_t sourceHash;
+    uint64_t sourceSize;
+    uint32_t nodes;
+    uint32_t lists;
+    uint32_t ifs;
+    uint32_t stringBytes;
+    uint32_t statements;
+    uint32_t symbols;
+    uint32_t symbolBytes;
+    uint32_t reserved;
+};
+
+uint64_t hashBytes(std::string_view bytes, uint64_t seed) {
+    const uint64_t multiplier = 0x9E3779B97F4A7C15ull;
+    uint64_t h = seed ^ (bytes.size() * multiplier);
+    const char* p = bytes.data();
+    const char* end = p + bytes.size();
+    auto mix = [&](uint64_t word) {
+        word *= 0xC2B2AE3D27D4EB4Full;
+        word = (word << 31) | (word >> 33);
+        h = (h ^ word) * multiplier;
+        h = (h << 27) | (h >> 37);
+    };
+    for (; end - p >= 8; p += 8) {
+        uint64_t word;
+        std::memcpy(&word, p, 8);
+        mix(word);
+    }
+    if (p < end) {
+        uint64_t word = 0;
+        std::memcpy(&word, p, static_cast<size_t>(end - p));
+        mix(word);
+    }
+    // Final avalanche, as in MurmurHash3's fmix64
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+uint64_t compilerHash() {
+    static const uint64_t value = hashBytes(kCompilerVersion, 0);
+    return value;
+}
+
+size_t aligned(size_t bytes) {
+    return (bytes + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+//Sizes of the sections after the header, in file order
+std::vector<size_t> sectionSizes(const Header& header) {
+    size_t nodes = header.nodes;
+    return {
+        nodes * sizeof(FlatKind),
+        nodes * sizeof(uint32_t),
+        nodes * sizeof(uint32_t),
+        nodes * sizeof(uint32_t),
+        nodes * sizeof(SourceOffset),
+        header.lists * sizeof(NodeIndex),
+        header.ifs * sizeof(FlatIf),
+        header.stringBytes,
+        header.statements * sizeof(NodeIndex),
+        header.symbols * sizeof(uint32_t),
+        header.symbolBytes,
+    };
+}
+
+//A read-only mapping of a whole file, unmapped when it goes away
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+            void* addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED) {
+                data = static_cast<const char*>(addr);
+                size = static_cast<size_t>(st.st_size);
+            }
+        }
+        close(fd);
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() {
+        if (data) {
+            munmap(const_cast<char*>(data), size);
+        }
+    }
+
+    const char* data = nullptr;
+    size_t size = 0;
+};
+
+template <typename T>
+void copySection(const char*& cursor, size_t bytes, std::vector<T>& out) {
+    out.resize(bytes / sizeof(T));
+    if (bytes != 0) {
+        std::memcpy(out.data(), cursor, bytes);
+    }
+    cursor += aligned(bytes);
+}
+
+//Whether every index in ast stays in range and every child comes before its
+//parent, so that the walks over a loaded entry neither read out of bounds
+//nor loop. The parser only ever writes such ASTs; a damaged file may not
+class Validator {
+public:
+    Validator(const FlatAst& ast, size_t symbols, size_t sourceSize)
+        : ast(ast), symbols(symbols), sourceSize(sourceSize) {}
+
+    bool valid() const {
+        size_t nodes = ast.size();
+        if (ast.a.size() != nodes || ast.b.size() != nodes || ast.c.size() != nodes || ast.offsets.size() != nodes) {
+            return false;
+        }
+        for (NodeIndex node = 0; node < nodes; ++node) {
+            if (!validNode(node)) {
+                return false;
+            }
+        }
+        for (NodeIndex statement : ast.statements) {
+            if (!isStatement(statement, nodes)) {
+                return false;
+            }
+        }
+        return singleParents();
+    }
+
+private:
+    const FlatAst& ast;
+    size_t symbols;
+    size_t sourceSize;
+
+    bool isStatement(NodeIndex node, size_t before) const {
+        return node < before && ast.kinds[node] >= FlatKind::BLOCK;
+    }
+
+    bool isBlock(NodeIndex node, size_t before) const {
+        return node < before && ast.kinds[node] == FlatKind::BLOCK;
+    }
+
+    // Every statement is listed once, by one block, if or the program;
+    // a shared one would be walked once per reference, exponentially often
+    // along a chain. Runs after validNode, so every reference is in range
+    bool singleParents() const {
+        std::vector<bool> referenced(ast.size(), false);
+        auto claim = [&referenced](NodeIndex statement) {
+            if (referenced[statement]) {
+                return false;
+            }
+            referenced[statement] = true;
+            return true;
+        };
+        for (NodeIndex node = 0; node < ast.size(); ++node) {
+            if (ast.kinds[node] == FlatKind::BLOCK) {
+                for (const NodeIndex* child = ast.blockBegin(node); child != ast.blockEnd(node); ++child) {
+                    if (!claim(*child)) {
+                        return false;
+                    }
+                }
+            } else if (ast.kinds[node] == FlatKind::IF) {
+                const FlatIf& branch = ast.ifs[ast.a[node]];
+                if (!claim(branch.thenBlock) || (branch.elseBlock != kNoNode && !claim(branch.elseBlock))) {
+                    return false;
+                }
+            }
+        }
+        for (NodeIndex statement : ast.statements) {
+            if (!claim(statement)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // A post-order subtree that ends before node and leaves one value
+    bool validExpression(FlatExpression expression, NodeIndex node) const {
+        if (expression.first > expression.root || expression.root >= node) {
+            return false;
+        }
+        size_t depth = 0;
+        for (NodeIndex child = expression.first; child <= expression.root; ++child) {
+            switch (ast.kinds[child]) {
+                case FlatKind::STRING_LITERAL:
+                case FlatKind::NUMBER_LITERAL:
+                case FlatKind::IDENTIFIER:
+                    ++depth;
+                    break;
+                case FlatKind::BINARY:
+                    if (depth < 2) {
+                        return false;
+                    }
+                    --depth;
+                    break;
+                default:
+                    return false;
+            }
+        }
+        return depth == 1;
+    }
+
+    bool validNode(NodeIndex node) const {
+        uint32_t a = ast.a[node];
+        uint32_t b = ast.b[node];
+        uint32_t c = ast.c[node];
+        if (ast.offsets[node] > sourceSize) {
+            return false;
+        }
+        switch (ast.kinds[node]) {
+            case FlatKind::STRING_LITERAL:
+                return static_cast<uint64_t>(a) + b <= ast.stringData.size();
+            case FlatKind::NUMBER_LITERAL:
+                return true;
+            case FlatKind::IDENTIFIER:
+                return a < symbols;
+            case FlatKind::BINARY:
+                return a < node && b < node && c <= static_cast<uint32_t>(BinaryOperator::NOT_EQUAL);
+            case FlatKind::BLOCK:
+                if (static_cast<uint64_t>(a) + b > ast.lists.size()) {
+                    return false;
+                }
+                for (const NodeIndex* child = ast.blockBegin(node); child != ast.blockEnd(node); ++child) {
+                    if (!isStatement(*child, node)) {
+                        return false;
+                    }
+                }
+                return true;
+            case FlatKind::IF: {
+                if (a >= ast.ifs.size()) {
+                    return false;
+                }
+                const FlatIf& branch = ast.ifs[a];
+                return validExpression(branch.condition, node) && isBlock(branch.thenBlock, node) &&
+                       (branch.elseBlock == kNoNode || isBlock(branch.elseBlock, node));
+            }
+            case FlatKind::VARIABLE_DECLARATION:
+            case FlatKind::ASSIGNMENT:
+                return a < symbols && validExpression(FlatExpression{b, c}, node);
+            case FlatKind::SHOW:
+                return validExpression(FlatExpression{a, b}, node);
+        }
+        return false; // a kind from outside the enum
+    }
+};
+
+//Appends to a FILE and remembers the first failure
+class SectionWriter {
+public:
+    explicit SectionWriter(std::FILE* file) : file(file) {}
+
+    void write(const void* data, size_t bytes) {
+        static const char padding[kAlignment] = {};
+        if (bytes != 0 && std::fwrite(data, 1, bytes, file) != bytes) {
+            failed = true;
+        }
+        size_t pad = aligned(bytes) - bytes;
+        if (pad != 0 && std::fwrite(padding, 1, pad, file) != pad) {
+            failed = true;
+        }
+    }
+
+    template <typename T>
+    void write(const std::vector<T>& items) {
+        write(items.data(), items.size() * sizeof(T));
+    }
+
+    bool failed = false;
+
+private:
+    std::FILE* file;
+};
+
+} // namespace
+
+AstCache::AstCache(std::string directory) : directory(std::move(directory)) {}
+
+uint64_t AstCache::hash(std::string_view bytes) {
+    return hashBytes(bytes, compilerHash());
+}
+
+std::string AstCache::path(std::string_view source) const {
+    return pathFor(hash(source));
+}
+
+std::string AstCache::pathFor(uint64_t sourceHash) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.gast", static_cast<unsigned long long>(sourceHash));
+    return directory + "/" + name;
+}
+
+bool AstCache::load(std::string_view source, StringInterner& symbols, FlatAst& ast) const {
+    uint64_t sourceHash = hash(source);
+    MappedFile file(pathFor(sourceHash));
+    if (file.size < sizeof(Header)) {
+        return false;
+    }
+    Header header;
+    std::memcpy(&header, file.data, sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.compilerHash != compilerHash() ||
+        header.sourceSize != source.size() || header.sourceHash != sourceHash) {
+        return false;
+    }
+    std::vector<size_t> sizes = sectionSizes(header);
+    size_t expected = aligned(sizeof(Header));
+    for (size_t bytes : sizes) {
+        expected += aligned(bytes);
+    }
+    if (expected != file.size) {
+        return false;
+    }
+
+    // Everything is checked before anything is filled in, so a rejected
+    // entry leaves ast and symbols untouched
+    const char* cursor = file.data + file.size - aligned(sizes[10]) - aligned(sizes[9]);
+    std::vector<uint32_t> lengths;
+    copySection(cursor, sizes[9], lengths);
+    uint64_t total = 0;
+    for (uint32_t length : lengths) {
+        total += length;
+    }
+    if (total != header.symbolBytes) {
+        return false;
+    }
+    const char* names = cursor;
+
+    FlatAst loaded;
+    cursor = file.data + aligned(sizeof(Header));
+    copySection(cursor, sizes[0], loaded.kinds);
+    copySection(cursor, sizes[1], loaded.a);
+    copySection(cursor, sizes[2], loaded.b);
+    copySection(cursor, sizes[3], loaded.c);
+    copySection(cursor, sizes[4], loaded.offsets);
+    copySection(cursor, sizes[5], loaded.lists);
+    copySection(cursor, sizes[6], loaded.ifs);
+    loaded.stringData.assign(cursor, sizes[7]);
+    cursor += aligned(sizes[7]);
+    copySection(cursor, sizes[8], loaded.statements);
+    if (!Validator(loaded, header.symbols, source.size()).valid()) {
+        return false;
+    }
+    ast = std::move(loaded);
+
+    // Cached ids are the order the symbols were first seen, so an empty
+    // interner takes the names as they are; otherwise identifiers are renumbered
+    if (symbols.size() == 0) {
+        for (SymbolId id = 0; id < header.symbols; ++id) {
+            symbols.append(std::string_view(names, lengths[id]));
+            names += lengths[id];
+        }
+        return true;
+    }
+    std::vector<SymbolId> remap(header.symbols);
+    for (SymbolId id = 0; id < header.symbols; ++id) {
+        remap[id] = symbols.intern(std::string_view(names, lengths[id]));
+        names += lengths[id];
+    }
+    for (NodeIndex node = 0; node < ast.size(); ++node) {
+        FlatKind kind = ast.kinds[node];
+        if (kind == FlatKind::IDENTIFIER || kind == FlatKind::VARIABLE_DECLARATION || kind == FlatKind::ASSIGNMENT) {
+            ast.a[node] = remap[ast.a[node]];
+        }
+    }
+    return true;
+}
+
+void AstCache::store(std::string_view source, const StringInterner& symbols, const FlatAst& ast) const {
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw std::runtime_error("Could not create AST cache directory: " + directory + ": " + std::strerror(errno));
+    }
+
+    Header header = {};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.compilerHash = compilerHash();
+    header.sourceHash = hash(source);
+    header.sourceSize = source.size();
+    header.nodes = static_cast<uint32_t>(ast.size());
+    header.lists = static_cast<uint32_t>(ast.lists.size());
+    header.ifs = static_cast<uint32_t>(ast.ifs.size());
+    header.stringBytes = static_cast<uint32_t>(ast.stringData.size());
+    header.statements = static_cast<uint32_t>(ast.statements.size());
+    header.symbols = static_cast<uint32_t>(symbols.size());
+    std::vector<uint32_t> lengths(symbols.size());
+    std::string names;
+    for (SymbolId id = 0; id < symbols.size(); ++id) {
+        lengths[id] = static_cast<uint32_t>(symbols.name(id).size());
+        names += symbols.name(id);
+    }
+    header.symbolBytes = static_cast<uint32_t>(names.size());
+
+    // Written under a private name and renamed into place, so a reader never
+    // sees a half-written entry
+    std::string target = pathFor(header.sourceHash);
+    std::string temporary = target + "." + std::to_string(getpid()) + ".tmp";
+    std::FILE* file = std::fopen(temporary.c_str(), "wb");
+    if (!file) {
+        throw std::runtime_error("Could not write AST cache: " + temporary + ": " + std::strerror(errno));
+    }
+    SectionWriter writer(file);
+    writer.write(&header, sizeof(header));
+    writer.write(ast.kinds);
+    writer.write(ast.a);
+    writer.write(ast.b);
+    writer.write(ast.c);
+    writer.write(ast.offsets);
+    writer.write(ast.lists);
+    writer.write(ast.ifs);
+    writer.write(ast.stringData.data(), ast.stringData.size());
+    writer.write(ast.statements);
+    writer.write(lengths);
+    writer.write(names.data(), names.size());
+    bool failed = writer.failed;
+    failed = std::fclose(file) != 0 || failed;
+    if (failed || std::rename(temporary.c_str(), target.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        throw std::runtime_error("Could not write AST cache: " + target);
+    }
+}
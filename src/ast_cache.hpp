@@ -0,0 +1,38 @@
+//
+//AstCache class definition
+//AstCache keeps the FlatAst of every source it has seen in a directory, one
+//file per source, named after a hash of the source bytes and the compiler
+//version. A cached file is the FlatAst's arrays written back to back, plus
+//the names of the symbols they refer to
+//Loading maps the file and copies each array in one go, so a cache hit
+//costs a hash of the source and a few memcpys instead of lexing and parsing
+#pragma once
+
+#include "flat_ast.hpp"
+#include "interner.hpp"
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+class AstCache {
+public:
+    explicit AstCache(std::string directory);
+
+    // Fills ast and interns its symbols into symbols when the cache holds
+    // source; returns false on a miss or when the cached file is unusable
+    bool load(std::string_view source, StringInterner& symbols, FlatAst& ast) const;
+    // Writes ast for source, creating the directory if needed; throws
+    // std::runtime_error when the file cannot be written
+    void store(std::string_view source, const StringInterner& symbols, const FlatAst& ast) const;
+
+    // Where the entry for source lives
+    std::string path(std::string_view source) const;
+
+    // Hash of the source bytes, also used for the file name
+    static uint64_t hash(std::string_view bytes);
+
+private:
+    std::string directory;
+
+    std::string pathFor(uint64_t sourceHash) const;
+};
@@ -1,17 +1,181 @@
+//
+//ASTVisitor: statically dispatched, non-recursive traversal base (CRTP)
+//A visitor derives from ASTVisitor<Itself> and hides the hooks it cares
+//about; walk() switches on each node's kind tag and calls the hooks on the
+//derived class directly, so they can be inlined and no vtable is involved
+//The walk keeps its own stacks instead of recursing, so arbitrarily deep
+//nesting cannot overflow the call stack
+//
+//Hook order:
+//  expressions   visitX after the node's operands (post-order)
+//  block         enterBlock, statements, exitBlock
+//  if            enterIfStatement, condition, afterIfCondition, then block,
+//                beforeElse, else block (if any), exitIfStatement
+//  declaration,  enterX, value/expression, exitX
+//  show, assign
+//An enter hook that returns false skips the node's children; the matching
+//exit hook still runs, so enter and exit always pair up
 #pragma once
 
-#include "ast_forward.hpp"
+#include "ast.hpp"
+#include <cstdint>
+#include <vector>
 
+template <typename Derived>
 class ASTVisitor {
 public:
-    virtual ~ASTVisitor() = default;
-    virtual void visitStringLiteral(StringLiteral* node) = 0;
-    virtual void visitNumberLiteral(NumberLiteral* node) = 0;
-    virtual void visitIdentifier(Identifier* node) = 0;
-    virtual void visitBinaryExpression(BinaryExpression* node) = 0;
-    virtual void visitBlock(Block* node) = 0;
-    virtual void visitIfStatement(IfStatement* node) = 0;
-    virtual void visitVariableDeclaration(VariableDeclaration* node) = 0;
-    virtual void visitShowStatement(ShowStatement* node) = 0;
-    virtual void visitAssignmentStatement(AssignmentStatement* node) = 0;
-}; 
\ No newline at end of file
+    //Walks a statement and everything below it
+    void walk(Statement* root) {
+        size_t base = statementStack.size();
+        enter(root);
+        while (statementStack.size() > base) {
+            StatementFrame& frame = statementStack.back();
+            if (frame.node->kind == NodeKind::BLOCK) {
+                Block* block = static_cast<Block*>(frame.node);
+                if (frame.step < block->statements.size()) {
+                    enter(block->statements[frame.step++]);
+                } else {
+                    statementStack.pop_back();
+                    derived().exitBlock(block);
+                }
+                continue;
+            }
+            IfStatement* node = static_cast<IfStatement*>(frame.node);
+            if (frame.step == 0) {
+                frame.step = 1;
+                derived().beforeElse(node);
+                if (node->elseBlock) {
+                    enter(node->elseBlock);
+                }
+            } else {
+                statementStack.pop_back();
+                derived().exitIfStatement(node);
+            }
+        }
+    }
+
+    //Walks an expression in post-order
+    void walk(Expression* root) {
+        size_t base = expressionStack.size();
+        expressionStack.push_back(ExpressionFrame{root, false});
+        while (expressionStack.size() > base) {
+            ExpressionFrame& frame = expressionStack.back();
+            if (frame.node->kind == NodeKind::BINARY_EXPRESSION && !frame.expanded) {
+                // Left is on top, so it is finished before right is started
+                BinaryExpression* binary = static_cast<BinaryExpression*>(frame.node);
+                frame.expanded = true;
+                expressionStack.push_back(ExpressionFrame{binary->right, false});
+                expressionStack.push_back(ExpressionFrame{binary->left, false});
+                continue;
+            }
+            Expression* node = frame.node;
+            expressionStack.pop_back();
+            visit(node);
+        }
+    }
+
+    //Default hooks
+    void visitStringLiteral(StringLiteral*) {}
+    void visitNumberLiteral(NumberLiteral*) {}
+    void visitIdentifier(Identifier*) {}
+    void visitBinaryExpression(BinaryExpression*) {}
+    bool enterBlock(Block*) { return true; }
+    void exitBlock(Block*) {}
+    bool enterIfStatement(IfStatement*) { return true; }
+    void afterIfCondition(IfStatement*) {}
+    void beforeElse(IfStatement*) {}
+    void exitIfStatement(IfStatement*) {}
+    bool enterVariableDeclaration(VariableDeclaration*) { return true; }
+    void exitVariableDeclaration(VariableDeclaration*) {}
+    bool enterShowStatement(ShowStatement*) { return true; }
+    void exitShowStatement(ShowStatement*) {}
+    bool enterAssignmentStatement(AssignmentStatement*) { return true; }
+    void exitAssignmentStatement(AssignmentStatement*) {}
+
+private:
+    //A block with the index of its next statement, or an if with step 0
+    //while its then block runs and step 1 while its else block runs
+    struct StatementFrame {
+        Statement* node;
+        size_t step;
+    };
+
+    struct ExpressionFrame {
+        Expression* node;
+        bool expanded; // operands already pushed
+    };
+
+    std::vector<StatementFrame> statementStack;
+    std::vector<ExpressionFrame> expressionStack;
+
+    Derived& derived() { return static_cast<Derived&>(*this); }
+
+    void visit(Expression* node) {
+        switch (node->kind) {
+            case NodeKind::STRING_LITERAL:
+                return derived().visitStringLiteral(static_cast<StringLiteral*>(node));
+            case NodeKind::NUMBER_LITERAL:
+                return derived().visitNumberLiteral(static_cast<NumberLiteral*>(node));
+            case NodeKind::IDENTIFIER:
+                return derived().visitIdentifier(static_cast<Identifier*>(node));
+            case NodeKind::BINARY_EXPRESSION:
+                return derived().visitBinaryExpression(static_cast<BinaryExpression*>(node));
+            default:
+                break;
+        }
+    }
+
+    //Runs a statement's hooks up to its first nested block, which is pushed
+    //for the loop in walk(Statement*); simple statements finish here
+    void enter(Statement* node) {
+        switch (node->kind) {
+            case NodeKind::BLOCK: {
+                Block* block = static_cast<Block*>(node);
+                if (derived().enterBlock(block)) {
+                    statementStack.push_back(StatementFrame{block, 0});
+                } else {
+                    derived().exitBlock(block);
+                }
+                break;
+            }
+            case NodeKind::IF_STATEMENT: {
+                IfStatement* ifStatement = static_cast<IfStatement*>(node);
+                if (derived().enterIfStatement(ifStatement)) {
+                    walk(ifStatement->condition);
+                    derived().afterIfCondition(ifStatement);
+                    statementStack.push_back(StatementFrame{ifStatement, 0});
+                    enter(ifStatement->thenBlock);
+                } else {
+                    derived().exitIfStatement(ifStatement);
+                }
+                break;
+            }
+            case NodeKind::VARIABLE_DECLARATION: {
+                VariableDeclaration* declaration = static_cast<VariableDeclaration*>(node);
+                if (derived().enterVariableDeclaration(declaration)) {
+                    walk(declaration->value);
+                }
+                derived().exitVariableDeclaration(declaration);
+                break;
+            }
+            case NodeKind::SHOW_STATEMENT: {
+                ShowStatement* show = static_cast<ShowStatement*>(node);
+                if (derived().enterShowStatement(show)) {
+                    walk(show->expression);
+                }
+                derived().exitShowStatement(show);
+                break;
+            }
+            case NodeKind::ASSIGNMENT_STATEMENT: {
+                AssignmentStatement* assignment = static_cast<AssignmentStatement*>(node);
+                if (derived().enterAssignmentStatement(assignment)) {
+                    walk(assignment->value);
+                }
+                derived().exitAssignmentStatement(assignment);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+};
@@ -1,35 +1,109 @@
 #include "ast.hpp"
+#include "flat_ast.hpp"
 #include "codegen.hpp"
 #include "errors.hpp"
+#include "log.hpp"
 #include <llvm/IR/Verifier.h> // verify the LLVM IR
 #include <llvm/Support/TargetSelect.h> // select the target
 #include <llvm/ExecutionEngine/ExecutionEngine.h> // execute the LLVM IR
 #include <llvm/ExecutionEngine/GenericValue.h> // store the LLVM generic value
 #include <llvm/Support/raw_ostream.h> // store the LLVM raw ostream
-#include <iostream> // for input and output
+#include <llvm/Support/TimeProfiler.h> // per-statement spans for --trace
 #include <llvm/ExecutionEngine/SectionMemoryManager.h> // store the LLVM section memory manager
+#include <llvm/Passes/PassBuilder.h> // build the -O pass pipelines
+#include <llvm/Target/TargetMachine.h> // target the pipelines at the host
+
+namespace {
+
+// LLVM's spelling of a type, for log lines
+std::string typeName(llvm::Type* type) {
+    std::string name;
+    llvm::raw_string_ostream out(name);
+    type->print(out);
+    return out.str();
+}
+
+// Detail of a top-level statement's trace span
+std::string statementDetail(SourceOffset offset) {
+    return "at byte " + std::to_string(offset);
+}
+
+// Section memory for the JIT that tallies the bytes of machine code
+class CountingMemoryManager : public llvm::SectionMemoryManager {
+public:
+    explicit CountingMemoryManager(size_t& codeBytes) : codeBytes(codeBytes) {}
+
+    uint8_t* allocateCodeSection(uintptr_t size, unsigned alignment, unsigned id, llvm::StringRef name) override {
+        codeBytes += size;
+        return SectionMemoryManager::allocateCodeSection(size, alignment, id, name);
+    }
+
+private:
+    size_t& codeBytes;
+};
+
+// Native target, asm printer and asm parser; safe to call more than once
+void initializeNativeTarget() {
+    GEHU_LOG(CODEGEN, DEBUG, "Initializing native target...");
+    if (llvm::InitializeNativeTarget()) {
+        throw CodeGenError("Failed to initialize native target", kNoOffset);
+    }
+    
+    GEHU_LOG(CODEGEN, DEBUG, "Initializing native target asm printer...");
+    if (llvm::InitializeNativeTargetAsmPrinter()) {
+        throw CodeGenError("Failed to initialize native target asm printer", kNoOffset);
+    }
+    
+    GEHU_LOG(CODEGEN, DEBUG, "Initializing native target asm parser...");
+    if (llvm::InitializeNativeTargetAsmParser()) {
+        throw CodeGenError("Failed to initialize native target asm parser", kNoOffset);
+    }
+}
+
+llvm::OptimizationLevel passLevel(CodeGenerator::OptLevel level) {
+    switch (level) {
+        case CodeGenerator::OptLevel::O0: return llvm::OptimizationLevel::O0;
+        case CodeGenerator::OptLevel::O1: return llvm::OptimizationLevel::O1;
+        case CodeGenerator::OptLevel::O2: return llvm::OptimizationLevel::O2;
+        case CodeGenerator::OptLevel::O3: return llvm::OptimizationLevel::O3;
+        case CodeGenerator::OptLevel::OS: return llvm::OptimizationLevel::Os;
+    }
+    return llvm::OptimizationLevel::O0;
+}
+
+// The instruction selection and scheduling effort that goes with a level
+auto backendLevel(CodeGenerator::OptLevel level) {
+    switch (level) {
+        case CodeGenerator::OptLevel::O0: return llvm::CodeGenOptLevel::None;
+        case CodeGenerator::OptLevel::O1: return llvm::CodeGenOptLevel::Less;
+        case CodeGenerator::OptLevel::O3: return llvm::CodeGenOptLevel::Aggressive;
+        default: return llvm::CodeGenOptLevel::Default;
+    }
+}
+
+} // namespace
 
 //CodeGenerator class constructor
-CodeGenerator::CodeGenerator() {
-    std::cout << "[CodeGen] Initializing LLVM context..." << std::endl;
+CodeGenerator::CodeGenerator(const StringInterner& symbols) : symbols(symbols) {
+    GEHU_LOG(CODEGEN, DEBUG, "Initializing LLVM context...");
     context = std::make_unique<llvm::LLVMContext>();
     if (!context) {
-        throw CodeGenError("Failed to create LLVM context", 0, 0);
+        throw CodeGenError("Failed to create LLVM context", kNoOffset);
     }
     
-    std::cout << "[CodeGen] Creating module..." << std::endl;
+    GEHU_LOG(CODEGEN, DEBUG, "Creating module...");
     module = std::make_unique<llvm::Module>("gehu", *context);
     if (!module) {
-        throw CodeGenError("Failed to create LLVM module", 0, 0);
+        throw CodeGenError("Failed to create LLVM module", kNoOffset);
     }
     
-    std::cout << "[CodeGen] Creating IR builder..." << std::endl;
+    GEHU_LOG(CODEGEN, DEBUG, "Creating IR builder...");
     builder = std::make_unique<llvm::IRBuilder<>>(*context);
     if (!builder) {
-        throw CodeGenError("Failed to create IR builder", 0, 0);
+        throw CodeGenError("Failed to create IR builder", kNoOffset);
     }
     
-    std::cout << "[CodeGen] Creating printf function..." << std::endl;
+    GEHU_LOG(CODEGEN, DEBUG, "Creating printf function...");
     createPrintfFunction();
 }
 
@@ -52,17 +126,66 @@ void CodeGenerator::createPrintfFunction() {
 
 void CodeGenerator::generate(Program* program) {
     if (!program) {
-        throw CodeGenError("Null program pointer", 0, 0);
+        throw CodeGenError("Null program pointer", kNoOffset);
     }
+    beginMain();
     
-    std::cout << "[CodeGen] Generating main function..." << std::endl;
+    for (const auto& statement : program->statements) {
+        if (!statement) {
+            throw CodeGenError("Null statement pointer", kNoOffset);
+        }
+        GEHU_LOG(CODEGEN, TRACE, "Visiting top-level statement...");
+        llvm::TimeTraceScope span("statement", [&] { return statementDetail(statement->offset); });
+        walk(statement);
+    }
+    
+    finishMain();
+}
+
+// for the flat AST: walkFlatStatements drives blocks and ifs
+struct CodeGenerator::FlatPass {
+    CodeGenerator& codegen;
+    const FlatAst& ast;
+
+    void enterBlock(NodeIndex node) {
+        GEHU_LOG(CODEGEN, TRACE, "Entering block with " << ast.b[node] << " statements.");
+    }
+    void exitBlock(NodeIndex) { GEHU_LOG(CODEGEN, TRACE, "Exiting block."); }
+    void enterIf(NodeIndex node) {
+        codegen.openIfs.push_back(codegen.beginIf(codegen.generateFlatExpression(ast, ast.ifs[ast.a[node]].condition)));
+    }
+    void beforeElse(NodeIndex) { codegen.beginElse(codegen.openIfs.back()); }
+    void exitIf(NodeIndex) {
+        codegen.endIf(codegen.openIfs.back());
+        codegen.openIfs.pop_back();
+    }
+    void statement(NodeIndex node) { codegen.generateFlatStatement(ast, node); }
+};
+
+void CodeGenerator::generate(const FlatAst& ast) {
+    beginMain();
+    
+    FlatPass pass{*this, ast};
+    for (NodeIndex statement : ast.statements) {
+        GEHU_LOG(CODEGEN, TRACE, "Visiting top-level statement...");
+        llvm::TimeTraceScope span("statement", [&] { return statementDetail(ast.offsets[statement]); });
+        walkFlatStatements(ast, statement, pass, flatStack);
+    }
+    
+    finishMain();
+}
+
+void CodeGenerator::beginMain() {
+    variables.assign(symbols.size(), nullptr);
+    
+    GEHU_LOG(CODEGEN, DEBUG, "Generating main function...");
     llvm::FunctionType* mainType = llvm::FunctionType::get(
         builder->getInt32Ty(),
         false
     );
     
     if (!mainType) {
-        throw CodeGenError("Failed to create main function type", 0, 0);
+        throw CodeGenError("Failed to create main function type", kNoOffset);
     }
     
     llvm::Function* mainFunction = llvm::Function::Create(
@@ -73,264 +196,386 @@ void CodeGenerator::generate(Program* program) {
     );
     
     if (!mainFunction) {
-        throw CodeGenError("Failed to create main function", 0, 0);
+        throw CodeGenError("Failed to create main function", kNoOffset);
     }
     
     llvm::BasicBlock* entry = llvm::BasicBlock::Create(*context, "entry", mainFunction);
     if (!entry) {
-        throw CodeGenError("Failed to create entry block", 0, 0);
+        throw CodeGenError("Failed to create entry block", kNoOffset);
     }
     
     builder->SetInsertPoint(entry);
-    
-    for (const auto& statement : program->statements) {
-        if (!statement) {
-            throw CodeGenError("Null statement pointer", 0, 0);
-        }
-        std::cout << "[CodeGen] Visiting top-level statement..." << std::endl;
-        statement->accept(*this);
-    }
-    
+}
+
+void CodeGenerator::finishMain() {
     builder->CreateRet(builder->getInt32(0));
-    
+}
+
+void CodeGenerator::verify() {
     std::string error;
     llvm::raw_string_ostream errorStream(error);
     if (llvm::verifyModule(*module, &errorStream)) {
-        std::cerr << "[CodeGen] Module verification failed: " << error << std::endl;
-        throw CodeGenError("Module verification failed: " + error, 0, 0);
+        throw CodeGenError("Module verification failed: " + error, kNoOffset);
     }
-    std::cout << "[CodeGen] Module verified successfully." << std::endl;
+    GEHU_LOG(CODEGEN, INFO, "Module verified successfully.");
 
     // Write the generated LLVM IR to a file for debugging
     std::error_code EC;
     llvm::raw_fd_ostream out("output.ll", EC);
     if (EC) {
-        throw CodeGenError("Failed to open output file: " + EC.message(), 0, 0);
+        throw CodeGenError("Failed to open output file: " + EC.message(), kNoOffset);
     }
     module->print(out, nullptr);
     out.flush();
-    std::cout << "[CodeGen] Generated LLVM IR written to output.ll" << std::endl;
+    GEHU_LOG(CODEGEN, INFO, "Generated LLVM IR written to output.ll");
 }
 
 void CodeGenerator::visitStringLiteral(StringLiteral* node) {
-    std::cout << "[CodeGen] StringLiteral: " << node->value << std::endl;
-    currentValue = builder->CreateGlobalStringPtr(node->value);
+    GEHU_LOG(CODEGEN, TRACE, "StringLiteral: " << node->value);
+    valueStack.push_back(builder->CreateGlobalStringPtr(node->value));
 }
 
 void CodeGenerator::visitNumberLiteral(NumberLiteral* node) {
-    std::cout << "[CodeGen] NumberLiteral: " << node->value << std::endl;
-    currentValue = builder->getInt32(node->value);
+    GEHU_LOG(CODEGEN, TRACE, "NumberLiteral: " << node->value);
+    valueStack.push_back(builder->getInt32(node->value));
 }
 
 void CodeGenerator::visitIdentifier(Identifier* node) {
-    std::cout << "[CodeGen] Identifier: " << node->name << std::endl;
-    if (variables.find(node->name) == variables.end()) {
-        std::cerr << "[CodeGen] Undefined variable: " << node->name << std::endl;
-        throw CodeGenError("Undefined variable: " + node->name, 0, 0);
-    }
-    currentValue = builder->CreateLoad(builder->getInt32Ty(), variables[node->name]);
+    GEHU_LOG(CODEGEN, TRACE, "Identifier: " << symbols.name(node->name));
+    llvm::AllocaInst* variable = lookupVariable(node->name, "Undefined variable: ", node->offset);
+    valueStack.push_back(builder->CreateLoad(builder->getInt32Ty(), variable));
 }
-// for binary expression
+// for binary expression; both operand values are on the stack
 void CodeGenerator::visitBinaryExpression(BinaryExpression* node) {
-    std::cout << "[CodeGen] BinaryExpression: op=" << static_cast<int>(node->op) << std::endl;
-    node->left->accept(*this);
-    llvm::Value* left = currentValue;
-    node->right->accept(*this);
-    llvm::Value* right = currentValue;
-    switch (node->op) {
+    GEHU_LOG(CODEGEN, TRACE, "BinaryExpression: op=" << static_cast<int>(node->op));
+    llvm::Value* right = popValue();
+    llvm::Value* left = popValue();
+    valueStack.push_back(emitBinary(node->op, left, right));
+}
+
+llvm::Value* CodeGenerator::popValue() {
+    llvm::Value* value = valueStack.back();
+    valueStack.pop_back();
+    return value;
+}
+
+llvm::Value* CodeGenerator::emitBinary(BinaryOperator op, llvm::Value* left, llvm::Value* right) {
+    switch (op) {
         case BinaryOperator::ADD:
-            currentValue = builder->CreateAdd(left, right);
-            break;
+            return builder->CreateAdd(left, right);
         case BinaryOperator::SUBTRACT:
-            currentValue = builder->CreateSub(left, right);
-            break;
+            return builder->CreateSub(left, right);
         case BinaryOperator::MULTIPLY:
-            currentValue = builder->CreateMul(left, right);
-            break;
+            return builder->CreateMul(left, right);
         case BinaryOperator::DIVIDE:
-            currentValue = builder->CreateSDiv(left, right);
-            break;
+            return builder->CreateSDiv(left, right);
         case BinaryOperator::GREATER_THAN:
-            currentValue = builder->CreateICmpSGT(left, right);
-            break;
+            return builder->CreateICmpSGT(left, right);
         case BinaryOperator::LESS_THAN:
-            currentValue = builder->CreateICmpSLT(left, right);
-            break;
+            return builder->CreateICmpSLT(left, right);
         case BinaryOperator::GREATER_EQUAL:
-            currentValue = builder->CreateICmpSGE(left, right);
-            break;
+            return builder->CreateICmpSGE(left, right);
         case BinaryOperator::LESS_EQUAL:
-            currentValue = builder->CreateICmpSLE(left, right);
-            break;
+            return builder->CreateICmpSLE(left, right);
         case BinaryOperator::EQUAL_EQUAL:
-            currentValue = builder->CreateICmpEQ(left, right);
-            break;
+            return builder->CreateICmpEQ(left, right);
         case BinaryOperator::NOT_EQUAL:
-            currentValue = builder->CreateICmpNE(left, right);
-            break;
+            return builder->CreateICmpNE(left, right);
     }
+    throw CodeGenError("Unknown binary operator", kNoOffset);
 }
 // for block
-void CodeGenerator::visitBlock(Block* node) {
-    std::cout << "[CodeGen] Entering block with " << node->statements.size() << " statements." << std::endl;
-    for (const auto& statement : node->statements) {
-        statement->accept(*this);
-    }
-    std::cout << "[CodeGen] Exiting block." << std::endl;
+bool CodeGenerator::enterBlock(Block* node) {
+    GEHU_LOG(CODEGEN, TRACE, "Entering block with " << node->statements.size() << " statements.");
+    return true;
+}
+
+void CodeGenerator::exitBlock(Block* node) {
+    GEHU_LOG(CODEGEN, TRACE, "Exiting block.");
 }
 // for if statement
-void CodeGenerator::visitIfStatement(IfStatement* node) {
-    std::cout << "[CodeGen] IfStatement: Generating condition..." << std::endl;
-    node->condition->accept(*this);
-    llvm::Value* condition = currentValue;
-    llvm::Function* function = builder->GetInsertBlock()->getParent();
-    llvm::BasicBlock* thenBlock = llvm::BasicBlock::Create(*context, "then", function);
-    llvm::BasicBlock* elseBlock = llvm::BasicBlock::Create(*context, "else", function);
-    llvm::BasicBlock* mergeBlock = llvm::BasicBlock::Create(*context, "ifcont", function);
-    builder->CreateCondBr(condition, thenBlock, elseBlock);
-    builder->SetInsertPoint(thenBlock);
-    std::cout << "[CodeGen] IfStatement: Generating then block..." << std::endl;
-    node->thenBlock->accept(*this);
-    builder->CreateBr(mergeBlock);
-    builder->SetInsertPoint(elseBlock);
+bool CodeGenerator::enterIfStatement(IfStatement* node) {
+    GEHU_LOG(CODEGEN, TRACE, "IfStatement: Generating condition...");
+    return true;
+}
+
+void CodeGenerator::afterIfCondition(IfStatement* node) {
+    openIfs.push_back(beginIf(popValue()));
+    GEHU_LOG(CODEGEN, TRACE, "IfStatement: Generating then block...");
+}
+
+void CodeGenerator::beforeElse(IfStatement* node) {
+    beginElse(openIfs.back());
     if (node->elseBlock) {
-        std::cout << "[CodeGen] IfStatement: Generating else block..." << std::endl;
-        node->elseBlock->accept(*this);
+        GEHU_LOG(CODEGEN, TRACE, "IfStatement: Generating else block...");
     }
-    builder->CreateBr(mergeBlock);
-    builder->SetInsertPoint(mergeBlock);
-    std::cout << "[CodeGen] IfStatement: Done." << std::endl;
+}
+
+void CodeGenerator::exitIfStatement(IfStatement* node) {
+    endIf(openIfs.back());
+    openIfs.pop_back();
+    GEHU_LOG(CODEGEN, TRACE, "IfStatement: Done.");
+}
+
+CodeGenerator::IfBlocks CodeGenerator::beginIf(llvm::Value* condition) {
+    llvm::Function* function = builder->GetInsertBlock()->getParent();
+    IfBlocks blocks;
+    blocks.thenBlock = llvm::BasicBlock::Create(*context, "then", function);
+    blocks.elseBlock = llvm::BasicBlock::Create(*context, "else", function);
+    blocks.mergeBlock = llvm::BasicBlock::Create(*context, "ifcont", function);
+    builder->CreateCondBr(condition, blocks.thenBlock, blocks.elseBlock);
+    builder->SetInsertPoint(blocks.thenBlock);
+    return blocks;
+}
+
+void CodeGenerator::beginElse(const IfBlocks& blocks) {
+    builder->CreateBr(blocks.mergeBlock);
+    builder->SetInsertPoint(blocks.elseBlock);
+}
+
+void CodeGenerator::endIf(const IfBlocks& blocks) {
+    builder->CreateBr(blocks.mergeBlock);
+    builder->SetInsertPoint(blocks.mergeBlock);
 }
 // for variable declaration
-void CodeGenerator::visitVariableDeclaration(VariableDeclaration* node) {
-    std::cout << "[CodeGen] VariableDeclaration: " << node->name << std::endl;
-    node->value->accept(*this);
-    StringLiteral* strLit = dynamic_cast<StringLiteral*>(node->value.get());
+bool CodeGenerator::enterVariableDeclaration(VariableDeclaration* node) {
+    GEHU_LOG(CODEGEN, TRACE, "VariableDeclaration: " << symbols.name(node->name));
+    return true;
+}
+
+void CodeGenerator::exitVariableDeclaration(VariableDeclaration* node) {
+    llvm::Value* value = popValue();
+    StringLiteral* strLit = nodeCast<StringLiteral>(node->value);
     if (strLit) {
         // For string literals, store the global string pointer directly
-        llvm::Value* strPtr = builder->CreateGlobalStringPtr(strLit->value);
-        llvm::AllocaInst* alloca = builder->CreateAlloca(strPtr->getType(), nullptr, node->name);
-        builder->CreateStore(strPtr, alloca);
-        variables[node->name] = alloca;
+        declareVariable(node->name, builder->CreateGlobalStringPtr(strLit->value));
     } else {
         // For non-string literals (e.g., numbers), allocate an integer
-        llvm::AllocaInst* alloca = builder->CreateAlloca(builder->getInt32Ty(), nullptr, node->name);
-        builder->CreateStore(currentValue, alloca);
-        variables[node->name] = alloca;
+        declareVariable(node->name, value);
     }
 }
-// for show statement
-void CodeGenerator::visitShowStatement(ShowStatement* node) {
-    std::cout << "[CodeGen] ShowStatement" << std::endl;
-    StringLiteral* strLit = dynamic_cast<StringLiteral*>(node->expression.get());
-    NumberLiteral* numLit = dynamic_cast<NumberLiteral*>(node->expression.get());
-    Identifier* ident = dynamic_cast<Identifier*>(node->expression.get());
+
+void CodeGenerator::declareVariable(SymbolId name, llvm::Value* value) {
+    std::string_view text = symbols.name(name);
+    llvm::AllocaInst* alloca = builder->CreateAlloca(value->getType(), nullptr, llvm::StringRef(text.data(), text.size()));
+    builder->CreateStore(value, alloca);
+    variables[name] = alloca;
+}
+// for show statement; only literals and variables can be shown, so the
+// expression is not walked
+bool CodeGenerator::enterShowStatement(ShowStatement* node) {
+    GEHU_LOG(CODEGEN, TRACE, "ShowStatement");
+    StringLiteral* strLit = nodeCast<StringLiteral>(node->expression);
+    NumberLiteral* numLit = nodeCast<NumberLiteral>(node->expression);
+    Identifier* ident = nodeCast<Identifier>(node->expression);
     if (strLit) {
         // Print string literal directly
-        llvm::Value* formatStr = builder->CreateGlobalStringPtr("%s\n");
-        llvm::Value* str = builder->CreateGlobalStringPtr(strLit->value);
-        std::vector<llvm::Value*> args = {formatStr, str};
-        builder->CreateCall(printfFunction, args);
+        emitPrint("%s\n", builder->CreateGlobalStringPtr(strLit->value));
     } else if (numLit) {
         // Print number
-        llvm::Value* formatStr = builder->CreateGlobalStringPtr("%d\n");
-        llvm::Value* num = builder->getInt32(numLit->value);
-        std::vector<llvm::Value*> args = {formatStr, num};
-        builder->CreateCall(printfFunction, args);
+        emitPrint("%d\n", builder->getInt32(numLit->value));
     } else if (ident) {
-        if (variables.find(ident->name) == variables.end()) {
-            throw CodeGenError("Undefined variable: " + ident->name, 0, 0);
+        emitShowVariable(ident->name, ident->offset);
+    } else {
+        throw CodeGenError("Unsupported expression in show statement", node->expression->offset);
+    }
+    return false;
+}
+
+void CodeGenerator::emitPrint(const char* format, llvm::Value* value) {
+    llvm::Value* formatStr = builder->CreateGlobalStringPtr(format);
+    std::vector<llvm::Value*> args = {formatStr, value};
+    builder->CreateCall(printfFunction, args);
+}
+
+void CodeGenerator::emitShowVariable(SymbolId name, SourceOffset offset) {
+    llvm::AllocaInst* varAlloca = lookupVariable(name, "Undefined variable: ", offset);
+    llvm::Type* varType = varAlloca->getAllocatedType();
+    GEHU_LOG(CODEGEN, TRACE, "ShowStatement: Variable " << symbols.name(name) << " has type: " << typeName(varType));
+    
+    if (varType->isIntegerTy(32)) {
+        // Print integer variable
+        emitPrint("%d\n", builder->CreateLoad(builder->getInt32Ty(), varAlloca));
+    } else if (varType->isPointerTy()) {
+        // Print string variable
+        emitPrint("%s\n", builder->CreateLoad(varType, varAlloca));
+    } else {
+        throw CodeGenError("Unsupported variable type in show statement: " + nameOf(name), offset);
+    }
+}
+// for assignment statement 
+bool CodeGenerator::enterAssignmentStatement(AssignmentStatement* node) {
+    lookupVariable(node->name, "Assignment to undeclared variable: ", node->offset);
+    return true;
+}
+
+void CodeGenerator::exitAssignmentStatement(AssignmentStatement* node) {
+    builder->CreateStore(popValue(), variables[node->name]);
+}
+
+// Declarations, shows and assignments of the flat AST
+void CodeGenerator::generateFlatStatement(const FlatAst& ast, NodeIndex statement) {
+    switch (ast.kinds[statement]) {
+        case FlatKind::VARIABLE_DECLARATION: {
+            FlatExpression value = ast.expression(statement);
+            llvm::Value* result = generateFlatExpression(ast, value);
+            if (ast.kinds[value.root] == FlatKind::STRING_LITERAL) {
+                result = builder->CreateGlobalStringPtr(ast.stringValue(value.root));
+            }
+            declareVariable(ast.a[statement], result);
+            break;
         }
-        llvm::Value* varAlloca = variables[ident->name];
-        llvm::AllocaInst* allocaInst = llvm::dyn_cast<llvm::AllocaInst>(varAlloca);
-        if (!allocaInst) {
-            throw CodeGenError("Variable is not an alloca instruction: " + ident->name, 0, 0);
+        case FlatKind::SHOW: {
+            NodeIndex root = ast.expression(statement).root;
+            switch (ast.kinds[root]) {
+                case FlatKind::STRING_LITERAL:
+                    emitPrint("%s\n", builder->CreateGlobalStringPtr(ast.stringValue(root)));
+                    break;
+                case FlatKind::NUMBER_LITERAL:
+                    emitPrint("%d\n", builder->getInt32(ast.numberValue(root)));
+                    break;
+                case FlatKind::IDENTIFIER:
+                    emitShowVariable(ast.a[root], ast.offsets[root]);
+                    break;
+                default:
+                    throw CodeGenError("Unsupported expression in show statement", ast.offsets[root]);
+            }
+            break;
         }
-        llvm::Type* varType = allocaInst->getAllocatedType();
-        std::cout << "[CodeGen] ShowStatement: Variable " << ident->name << " has type: ";
-        varType->print(llvm::errs());
-        std::cout << std::endl;
-        
-        if (varType->isIntegerTy(32)) {
-            // Print integer variable
-            llvm::Value* formatStr = builder->CreateGlobalStringPtr("%d\n");
-            llvm::Value* val = builder->CreateLoad(builder->getInt32Ty(), varAlloca);
-            std::vector<llvm::Value*> args = {formatStr, val};
-            builder->CreateCall(printfFunction, args);
-        } else if (varType->isPointerTy()) {
-            // Print string variable
-            llvm::Value* formatStr = builder->CreateGlobalStringPtr("%s\n");
-            llvm::Value* val = builder->CreateLoad(varType, varAlloca);
-            std::vector<llvm::Value*> args = {formatStr, val};
-            builder->CreateCall(printfFunction, args);
-        } else {
-            throw CodeGenError("Unsupported variable type in show statement: " + ident->name, 0, 0);
+        case FlatKind::ASSIGNMENT: {
+            llvm::AllocaInst* variable = lookupVariable(ast.a[statement], "Assignment to undeclared variable: ", ast.offsets[statement]);
+            builder->CreateStore(generateFlatExpression(ast, ast.expression(statement)), variable);
+            break;
         }
-    } else {
-        throw CodeGenError("Unsupported expression in show statement", 0, 0);
+        default:
+            throw CodeGenError("Expression node in statement position", ast.offsets[statement]);
     }
 }
-// for assignment statement 
-void CodeGenerator::visitAssignmentStatement(AssignmentStatement* node) {
-    if (variables.find(node->name) == variables.end()) {
-        throw CodeGenError("Assignment to undeclared variable: " + node->name, 0, 0);
+
+// Post-order expressions are evaluated by one sweep with a value stack
+llvm::Value* CodeGenerator::generateFlatExpression(const FlatAst& ast, FlatExpression expression) {
+    valueStack.clear();
+    for (NodeIndex node = expression.first; node <= expression.root; ++node) {
+        switch (ast.kinds[node]) {
+            case FlatKind::STRING_LITERAL:
+                valueStack.push_back(builder->CreateGlobalStringPtr(ast.stringValue(node)));
+                break;
+            case FlatKind::NUMBER_LITERAL:
+                valueStack.push_back(builder->getInt32(ast.numberValue(node)));
+                break;
+            case FlatKind::IDENTIFIER: {
+                llvm::AllocaInst* variable = lookupVariable(ast.a[node], "Undefined variable: ", ast.offsets[node]);
+                valueStack.push_back(builder->CreateLoad(builder->getInt32Ty(), variable));
+                break;
+            }
+            case FlatKind::BINARY: {
+                llvm::Value* right = valueStack.back();
+                valueStack.pop_back();
+                valueStack.back() = emitBinary(ast.binaryOperator(node), valueStack.back(), right);
+                break;
+            }
+            default:
+                throw CodeGenError("Statement node inside an expression", ast.offsets[node]);
+        }
+    }
+    return valueStack.back();
+}
+
+llvm::AllocaInst* CodeGenerator::lookupVariable(SymbolId name, const char* what, SourceOffset offset) {
+    llvm::AllocaInst* variable = variables[name];
+    if (!variable) {
+        throw CodeGenError(what + nameOf(name), offset);
     }
-    node->value->accept(*this);
-    builder->CreateStore(currentValue, variables[node->name]);
+    return variable;
 }
-// for run  
+// for run
 void CodeGenerator::run() {
-    std::cout << "[CodeGen] Initializing native target..." << std::endl;
-    if (llvm::InitializeNativeTarget()) {
-        throw CodeGenError("Failed to initialize native target", 0, 0);
+    prepare();
+    execute();
+}
+
+// The new pass manager's default pipeline for the level, tuned for the host
+// through its target machine; O0 leaves the module as generated
+void CodeGenerator::optimize() {
+    if (!module) {
+        throw CodeGenError("Module was already handed to the JIT", kNoOffset);
     }
-    
-    std::cout << "[CodeGen] Initializing native target asm printer..." << std::endl;
-    if (llvm::InitializeNativeTargetAsmPrinter()) {
-        throw CodeGenError("Failed to initialize native target asm printer", 0, 0);
+    optimized = true;
+    if (optLevel == OptLevel::O0) {
+        return;
     }
-    
-    std::cout << "[CodeGen] Initializing native target asm parser..." << std::endl;
-    if (llvm::InitializeNativeTargetAsmParser()) {
-        throw CodeGenError("Failed to initialize native target asm parser", 0, 0);
+    initializeNativeTarget();
+
+    GEHU_LOG(CODEGEN, DEBUG, "Creating target machine...");
+    std::unique_ptr<llvm::TargetMachine> machine(llvm::EngineBuilder().setOptLevel(backendLevel(optLevel)).selectTarget());
+    if (!machine) {
+        throw CodeGenError("Failed to create target machine", kNoOffset);
+    }
+    // The JIT would set these itself, but the passes need them first
+    module->setDataLayout(machine->createDataLayout());
+    module->setTargetTriple(machine->getTargetTriple().str());
+
+    GEHU_LOG(CODEGEN, DEBUG, "Running the pass pipeline...");
+    // Declared in this order so that they are destroyed in the reverse
+    llvm::LoopAnalysisManager loopAnalyses;
+    llvm::FunctionAnalysisManager functionAnalyses;
+    llvm::CGSCCAnalysisManager cgsccAnalyses;
+    llvm::ModuleAnalysisManager moduleAnalyses;
+    llvm::PassBuilder passes(machine.get());
+    passes.registerModuleAnalyses(moduleAnalyses);
+    passes.registerCGSCCAnalyses(cgsccAnalyses);
+    passes.registerFunctionAnalyses(functionAnalyses);
+    passes.registerLoopAnalyses(loopAnalyses);
+    passes.crossRegisterProxies(loopAnalyses, functionAnalyses, cgsccAnalyses, moduleAnalyses);
+    llvm::ModulePassManager pipeline = passes.buildPerModuleDefaultPipeline(passLevel(optLevel));
+    pipeline.run(*module, moduleAnalyses);
+    GEHU_LOG(CODEGEN, INFO, "Module optimized.");
+}
+
+// JIT-compiles the module; it belongs to the engine from here on
+void CodeGenerator::prepare() {
+    if (!optimized) {
+        optimize();
     }
+    initializeNativeTarget();
     
-    std::cout << "[CodeGen] Creating execution engine..." << std::endl;
+    GEHU_LOG(CODEGEN, DEBUG, "Creating execution engine...");
     std::string error;
-    // Create a temporary unique_ptr for the module
-    std::unique_ptr<llvm::Module> tempModule = std::move(module);
-    llvm::EngineBuilder builder(std::move(tempModule));
+    llvm::EngineBuilder builder(std::move(module));
     builder.setErrorStr(&error);
     builder.setVerifyModules(true);
-    builder.setOptLevel(llvm::CodeGenOptLevel::None);  // Disable optimizations for debugging
+    builder.setOptLevel(backendLevel(optLevel));
+    builder.setMCJITMemoryManager(std::make_unique<CountingMemoryManager>(codeBytes));
     
-    llvm::ExecutionEngine* engine = builder.create();
+    engine.reset(builder.create());
     if (!engine) {
-        throw CodeGenError("Failed to create execution engine: " + error, 0, 0);
+        throw CodeGenError("Failed to create execution engine: " + error, kNoOffset);
     }
 
     // Register printf symbol for JIT
     engine->addGlobalMapping("printf", (uint64_t)&printf);
 
-    std::cout << "[CodeGen] Getting main function pointer..." << std::endl;
-    llvm::Function* mainFunc = engine->FindFunctionNamed("main");
-    if (!mainFunc) {
-        delete engine;
-        throw CodeGenError("Failed to find main function", 0, 0);
+    GEHU_LOG(CODEGEN, DEBUG, "Getting main function pointer...");
+    mainFunction = engine->FindFunctionNamed("main");
+    if (!mainFunction) {
+        throw CodeGenError("Failed to find main function", kNoOffset);
     }
-    
-    std::cout << "[CodeGen] Executing main..." << std::endl;
+    // Machine code is emitted here rather than on the first call
+    engine->finalizeObject();
+}
+
+void CodeGenerator::execute() {
+    if (!engine) {
+        throw CodeGenError("Program was not prepared for execution", kNoOffset);
+    }
+    GEHU_LOG(CODEGEN, DEBUG, "Executing main...");
     try {
         // Use runFunction instead of getPointerToFunction
         std::vector<llvm::GenericValue> noargs;
-        engine->runFunction(mainFunc, noargs);
+        engine->runFunction(mainFunction, noargs);
     } catch (const std::exception& e) {
-        delete engine;
-        throw CodeGenError("Exception during execution: " + std::string(e.what()), 0, 0);
+        throw CodeGenError("Exception during execution: " + std::string(e.what()), kNoOffset);
     } catch (...) {
-        delete engine;
-        throw CodeGenError("Unknown exception during execution", 0, 0);
+        throw CodeGenError("Unknown exception during execution", kNoOffset);
     }
-    
-    delete engine; // delete the execution engine
-} 
\ No newline at end of file
+}
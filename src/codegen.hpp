@@ -1,6 +1,9 @@
 #pragma once
 
+#include "ast.hpp" // for BinaryOperator
 #include "ast_visitor.hpp"
+#include "flat_ast.hpp" // for NodeIndex, FlatExpression
+#include "interner.hpp" // for SymbolId
 #include <llvm/IR/LLVMContext.h> // store the LLVM context
 #include <llvm/IR/Module.h> // store the LLVM module
 #include <llvm/IR/IRBuilder.h> // build the LLVM IR
@@ -8,34 +11,96 @@
 #include <llvm/ExecutionEngine/ExecutionEngine.h> // execute the LLVM IR
 #include <llvm/ExecutionEngine/GenericValue.h> // store the LLVM generic value
 #include <llvm/Support/TargetSelect.h> // select the target
-#include <map> // store the variables
-#include <string> // store the variable names
+#include <memory>
+#include <string> // for error messages
+#include <vector> // store the variables
 
 // inherit from ASTVisitor
-class CodeGenerator : public ASTVisitor {
+class CodeGenerator : public ASTVisitor<CodeGenerator> {
 public:
-    CodeGenerator();
+    // IR pass pipeline and backend level, as the driver's -O flags
+    enum class OptLevel {
+        O0, // no IR passes
+        O1,
+        O2,
+        O3,
+        OS // O2, favouring size
+    };
+
+    explicit CodeGenerator(const StringInterner& symbols);
+    void setOptLevel(OptLevel level) { optLevel = level; }
+    // Emits the program's IR
     void generate(Program* program);
+    void generate(const FlatAst& ast);
+    // Checks the IR and writes it to output.ll; throws CodeGenError when it is malformed
+    void verify();
+    // Runs the level's pass pipeline on the module; prepare() does it when it has not run
+    void optimize();
+    // JIT-compiles the module, then runs its main; run() does both
+    void prepare();
+    void execute();
     void run();
 
-    // Visitor methods
-    void visitStringLiteral(StringLiteral* node) override;
-    void visitNumberLiteral(NumberLiteral* node) override;
-    void visitIdentifier(Identifier* node) override;
-    void visitBinaryExpression(BinaryExpression* node) override;
-    void visitBlock(Block* node) override;
-    void visitIfStatement(IfStatement* node) override;
-    void visitVariableDeclaration(VariableDeclaration* node) override;
-    void visitShowStatement(ShowStatement* node) override;
-    void visitAssignmentStatement(AssignmentStatement* node) override;
+    // Null once prepare() has handed the module to the JIT
+    const llvm::Module* getModule() const { return module.get(); }
+    // Machine code emitted by prepare()
+    size_t machineCodeBytes() const { return codeBytes; }
+
+    // ASTVisitor hooks; expression values go on valueStack
+    void visitStringLiteral(StringLiteral* node);
+    void visitNumberLiteral(NumberLiteral* node);
+    void visitIdentifier(Identifier* node);
+    void visitBinaryExpression(BinaryExpression* node);
+    bool enterBlock(Block* node);
+    void exitBlock(Block* node);
+    bool enterIfStatement(IfStatement* node);
+    void afterIfCondition(IfStatement* node);
+    void beforeElse(IfStatement* node);
+    void exitIfStatement(IfStatement* node);
+    bool enterVariableDeclaration(VariableDeclaration* node);
+    void exitVariableDeclaration(VariableDeclaration* node);
+    bool enterShowStatement(ShowStatement* node);
+    bool enterAssignmentStatement(AssignmentStatement* node);
+    void exitAssignmentStatement(AssignmentStatement* node);
 
 private:
+    struct FlatPass; // walkFlatStatements visitor
+
+    // Basic blocks of an if statement while it is being generated
+    struct IfBlocks {
+        llvm::BasicBlock* thenBlock;
+        llvm::BasicBlock* elseBlock;
+        llvm::BasicBlock* mergeBlock;
+    };
+
     void createPrintfFunction();
+    void beginMain();
+    void finishMain();
+    llvm::Value* emitBinary(BinaryOperator op, llvm::Value* left, llvm::Value* right);
+    void emitPrint(const char* format, llvm::Value* value);
+    void emitShowVariable(SymbolId name, SourceOffset offset);
+    void declareVariable(SymbolId name, llvm::Value* value);
+    IfBlocks beginIf(llvm::Value* condition);
+    void beginElse(const IfBlocks& blocks);
+    void endIf(const IfBlocks& blocks);
+    llvm::Value* popValue();
+    void generateFlatStatement(const FlatAst& ast, NodeIndex statement);
+    llvm::Value* generateFlatExpression(const FlatAst& ast, FlatExpression expression);
+    llvm::AllocaInst* lookupVariable(SymbolId name, const char* what, SourceOffset offset);
+    std::string nameOf(SymbolId name) const { return std::string(symbols.name(name)); }
     
+    const StringInterner& symbols; // names for diagnostics and IR values    
     std::unique_ptr<llvm::LLVMContext> context; // store the LLVM context
     std::unique_ptr<llvm::Module> module; // store the LLVM module
     std::unique_ptr<llvm::IRBuilder<>> builder; // build the LLVM IR
     llvm::Function* printfFunction; // store the printf function
-    std::map<std::string, llvm::Value*> variables; // store the variables
-    llvm::Value* currentValue; // store the current value
+    std::vector<llvm::AllocaInst*> variables; // indexed by SymbolId, null when undeclared
+    std::vector<llvm::Value*> valueStack; // values of the expressions being generated
+    std::vector<IfBlocks> openIfs; // if statements being generated, innermost last
+    std::vector<FlatFrame> flatStack;
+    std::unique_ptr<llvm::ExecutionEngine> engine; // owns the module after prepare()
+    llvm::Function* mainFunction = nullptr; // in engine
+    size_t codeBytes = 0;
+    OptLevel optLevel = OptLevel::O0;
+    bool optimized = false;
 }; 
\ No newline at end of file
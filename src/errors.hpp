@@ -1,41 +1,103 @@
 #pragma once
 
+#include "source_location.hpp"
+#include <cstddef>
 #include <stdexcept>
 #include <string>
+#include <utility>
+#include <vector>
 
+//offset is the byte offset the error points at, or kNoOffset when it has no
+//position; the driver turns it into line and column when printing
 class CompilerError : public std::runtime_error {
 public:
-    CompilerError(const std::string& message, size_t line, size_t column)
-        : std::runtime_error(message), line(line), column(column) {}
-    
-    size_t getLine() const { return line; }
-    size_t getColumn() const { return column; }
-    
+    CompilerError(const std::string& message, SourceOffset offset)
+        : std::runtime_error(message), offset(offset) {}
+
+    SourceOffset getOffset() const { return offset; }
+    bool hasLocation() const { return offset != kNoOffset; }
+
 private:
-    size_t line;
-    size_t column;
+    SourceOffset offset;
 };
 
 class LexerError : public CompilerError {
 public:
-    LexerError(const std::string& message, size_t line, size_t column)
-        : CompilerError("Lexer error: " + message, line, column) {}
+    LexerError(const std::string& message, SourceOffset offset)
+        : CompilerError("Lexer error: " + message, offset) {}
 };
 
 class ParserError : public CompilerError {
 public:
-    ParserError(const std::string& message, size_t line, size_t column)
-        : CompilerError("Parser error: " + message, line, column) {}
+    ParserError(const std::string& message, SourceOffset offset)
+        : CompilerError("Parser error: " + message, offset) {}
 };
 
 class SemanticError : public CompilerError {
 public:
-    SemanticError(const std::string& message, size_t line, size_t column)
-        : CompilerError("Semantic error: " + message, line, column) {}
+    SemanticError(const std::string& message, SourceOffset offset)
+        : CompilerError("Semantic error: " + message, offset) {}
 };
 
 class CodeGenError : public CompilerError {
 public:
-    CodeGenError(const std::string& message, size_t line, size_t column)
-        : CompilerError("Code generation error: " + message, line, column) {}
-}; 
\ No newline at end of file
+    CodeGenError(const std::string& message, SourceOffset offset)
+        : CompilerError("Code generation error: " + message, offset) {}
+};
+
+//Every error a phase found before it gave up, in the order they were found
+//Derives from CompilerError so a caller that only wants one error sees the first
+class CompilerErrorList : public CompilerError {
+public:
+    CompilerErrorList(std::vector<CompilerError> errors, bool truncated)
+        : CompilerError(errors.front()), errors(std::move(errors)), truncated(truncated) {}
+
+    const std::vector<CompilerError>& getErrors() const { return errors; }
+    //The error limit was reached, so there may be more errors after these
+    bool isTruncated() const { return truncated; }
+
+private:
+    std::vector<CompilerError> errors;
+    bool truncated;
+};
+
+//Collects the errors of a phase that recovers and keeps going
+//report() throws the list as soon as the limit is reached; finish() throws
+//it at the end of the phase if anything was reported
+//The collector keeps its errors after throwing, so a phase that is redone
+//from some point on can truncate() back to the errors found before it
+class ErrorCollector {
+public:
+    static constexpr size_t kDefaultLimit = 20;
+
+    //0 means no limit
+    void setLimit(size_t value) { limit = value; }
+    size_t getLimit() const { return limit; }
+
+    void report(const CompilerError& error) {
+        errors.push_back(error);
+        if (limit != 0 && errors.size() >= limit) {
+            throwErrors(true);
+        }
+    }
+
+    void finish() {
+        if (!errors.empty()) {
+            throwErrors(false);
+        }
+    }
+
+    void clear() { errors.clear(); }
+    bool empty() const { return errors.empty(); }
+    size_t size() const { return errors.size(); }
+    //Drops every error after the first count
+    void truncate(size_t count) { errors.erase(errors.begin() + count, errors.end()); }
+
+private:
+    std::vector<CompilerError> errors;
+    size_t limit = kDefaultLimit;
+
+    [[noreturn]] void throwErrors(bool truncated) {
+        throw CompilerErrorList(errors, truncated);
+    }
+};
@@ -0,0 +1,103 @@
+#include "flat_ast.hpp"
+
+FlatExpression FlatAst::expression(NodeIndex statement) const {
+    switch (kinds[statement]) {
+        case FlatKind::SHOW:
+            return FlatExpression{a[statement], b[statement]};
+        case FlatKind::VARIABLE_DECLARATION:
+        case FlatKind::ASSIGNMENT:
+            return FlatExpression{b[statement], c[statement]};
+        case FlatKind::IF:
+            return ifs[a[statement]].condition;
+        default:
+            return FlatExpression{kNoNode, kNoNode};
+    }
+}
+
+static bool operator==(const FlatIf& left, const FlatIf& right) {
+    return left.condition.first == right.condition.first && left.condition.root == right.condition.root &&
+           left.thenBlock == right.thenBlock && left.elseBlock == right.elseBlock;
+}
+
+bool FlatAst::operator==(const FlatAst& other) const {
+    return kinds == other.kinds && a == other.a && b == other.b && c == other.c && offsets == other.offsets &&
+           lists == other.lists && ifs == other.ifs && stringData == other.stringData &&
+           statements == other.statements;
+}
+
+void FlatAst::shrinkToFit() {
+    kinds.shrink_to_fit();
+    a.shrink_to_fit();
+    b.shrink_to_fit();
+    c.shrink_to_fit();
+    offsets.shrink_to_fit();
+    lists.shrink_to_fit();
+    ifs.shrink_to_fit();
+    stringData.shrink_to_fit();
+    statements.shrink_to_fit();
+}
+
+size_t FlatAst::memoryUsage() const {
+    return kinds.capacity() * sizeof(FlatKind) +
+           (a.capacity() + b.capacity() + c.capacity()) * sizeof(uint32_t) +
+           offsets.capacity() * sizeof(SourceOffset) +
+           (lists.capacity() + statements.capacity()) * sizeof(NodeIndex) +
+           ifs.capacity() * sizeof(FlatIf) + stringData.capacity();
+}
+
+NodeIndex FlatAstBuilder::add(FlatKind kind, uint32_t a, uint32_t b, uint32_t c, SourceOffset offset) {
+    NodeIndex index = static_cast<NodeIndex>(ast.kinds.size());
+    ast.kinds.push_back(kind);
+    ast.a.push_back(a);
+    ast.b.push_back(b);
+    ast.c.push_back(c);
+    ast.offsets.push_back(offset);
+    return index;
+}
+
+FlatExpression FlatAstBuilder::stringLiteral(std::string_view value, SourceOffset offset) {
+    uint32_t start = static_cast<uint32_t>(ast.stringData.size());
+    ast.stringData.append(value.data(), value.size());
+    NodeIndex node = add(FlatKind::STRING_LITERAL, start, static_cast<uint32_t>(value.size()), 0, offset);
+    return FlatExpression{node, node};
+}
+
+FlatExpression FlatAstBuilder::numberLiteral(int value, SourceOffset offset) {
+    NodeIndex node = add(FlatKind::NUMBER_LITERAL, static_cast<uint32_t>(value), 0, 0, offset);
+    return FlatExpression{node, node};
+}
+
+FlatExpression FlatAstBuilder::identifier(SymbolId name, SourceOffset offset) {
+    NodeIndex node = add(FlatKind::IDENTIFIER, name, 0, 0, offset);
+    return FlatExpression{node, node};
+}
+
+FlatExpression FlatAstBuilder::binary(FlatExpression left, BinaryOperator op, FlatExpression right, SourceOffset offset) {
+    // Both operands were emitted just before, so the subtree starts where left does
+    NodeIndex node = add(FlatKind::BINARY, left.root, right.root, static_cast<uint32_t>(op), offset);
+    return FlatExpression{left.first, node};
+}
+
+NodeIndex FlatAstBuilder::block(const NodeIndex* statements, size_t count, SourceOffset offset) {
+    uint32_t start = static_cast<uint32_t>(ast.lists.size());
+    ast.lists.insert(ast.lists.end(), statements, statements + count);
+    return add(FlatKind::BLOCK, start, static_cast<uint32_t>(count), 0, offset);
+}
+
+NodeIndex FlatAstBuilder::ifStatement(FlatExpression condition, NodeIndex thenBlock, NodeIndex elseBlock, SourceOffset offset) {
+    uint32_t index = static_cast<uint32_t>(ast.ifs.size());
+    ast.ifs.push_back(FlatIf{condition, thenBlock, elseBlock});
+    return add(FlatKind::IF, index, 0, 0, offset);
+}
+
+NodeIndex FlatAstBuilder::variableDeclaration(SymbolId name, FlatExpression value, SourceOffset offset) {
+    return add(FlatKind::VARIABLE_DECLARATION, name, value.first, value.root, offset);
+}
+
+NodeIndex FlatAstBuilder::showStatement(FlatExpression expression, SourceOffset offset) {
+    return add(FlatKind::SHOW, expression.first, expression.root, 0, offset);
+}
+
+NodeIndex FlatAstBuilder::assignmentStatement(SymbolId name, FlatExpression value, SourceOffset offset) {
+    return add(FlatKind::ASSIGNMENT, name, value.first, value.root, offset);
+}
@@ -0,0 +1,170 @@
+//
+//Flat AST: an alternative, index-based representation of a Program
+//Nodes live in parallel arrays (structure of arrays) indexed by NodeIndex
+//Expressions are stored in post-order, so every expression subtree is the
+//contiguous index range [first, root] and can be evaluated by one linear
+//sweep over that range with a value stack
+//
+//offsets holds each node's source position, as on the tree nodes
+//Node operands by kind:
+//  STRING_LITERAL        a = offset into stringData, b = length
+//  NUMBER_LITERAL        a = value (two's complement)
+//  IDENTIFIER            a = SymbolId
+//  BINARY                a = left, b = right, c = BinaryOperator
+//  BLOCK                 a = offset into lists, b = statement count
+//  IF                    a = index into ifs
+//  VARIABLE_DECLARATION  a = SymbolId, b = value first, c = value root
+//  SHOW                  a = expression first, b = expression root
+//  ASSIGNMENT            a = SymbolId, b = value first, c = value root
+#pragma once
+
+#include "ast.hpp"
+#include "interner.hpp"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using NodeIndex = uint32_t;
+constexpr NodeIndex kNoNode = UINT32_MAX;
+
+enum class FlatKind : uint8_t {
+    STRING_LITERAL,
+    NUMBER_LITERAL,
+    IDENTIFIER,
+    BINARY,
+    BLOCK,
+    IF,
+    VARIABLE_DECLARATION,
+    SHOW,
+    ASSIGNMENT
+};
+
+//Index range of one post-order expression subtree
+struct FlatExpression {
+    NodeIndex first;
+    NodeIndex root;
+};
+
+struct FlatIf {
+    FlatExpression condition;
+    NodeIndex thenBlock;
+    NodeIndex elseBlock; // kNoNode when there is no else
+};
+
+class FlatAst {
+public:
+    std::vector<FlatKind> kinds;
+    std::vector<uint32_t> a;
+    std::vector<uint32_t> b;
+    std::vector<uint32_t> c;
+    std::vector<SourceOffset> offsets;
+
+    std::vector<NodeIndex> lists; // block statement lists
+    std::vector<FlatIf> ifs;
+    std::string stringData; // string literal bytes
+    std::vector<NodeIndex> statements; // top-level statements in order
+
+    size_t size() const { return kinds.size(); }
+
+    std::string_view stringValue(NodeIndex node) const {
+        return std::string_view(stringData.data() + a[node], b[node]);
+    }
+    int32_t numberValue(NodeIndex node) const { return static_cast<int32_t>(a[node]); }
+    BinaryOperator binaryOperator(NodeIndex node) const { return static_cast<BinaryOperator>(c[node]); }
+    FlatExpression expression(NodeIndex statement) const;
+    const NodeIndex* blockBegin(NodeIndex block) const { return lists.data() + a[block]; }
+    const NodeIndex* blockEnd(NodeIndex block) const { return lists.data() + a[block] + b[block]; }
+
+    // Node for node the same AST, as when a cached AST is checked against a fresh parse
+    bool operator==(const FlatAst& other) const;
+    bool operator!=(const FlatAst& other) const { return !(*this == other); }
+
+    // Drops the growth slack once the AST is complete
+    void shrinkToFit();
+    // Bytes held by the arrays
+    size_t memoryUsage() const;
+};
+
+//Position in a block or if statement during walkFlatStatements
+struct FlatFrame {
+    NodeIndex node;
+    uint32_t step; // next statement of a block; 0/1 for an if's then/else
+};
+
+//Walks the statement root and the blocks below it with an explicit stack
+//(stack is scratch space the caller keeps between walks), calling:
+//  enterBlock(block) ... exitBlock(block)
+//  enterIf(if), then block, beforeElse(if), else block (if any), exitIf(if)
+//  statement(node) for every declaration, show and assignment
+template <typename Visitor>
+void walkFlatStatements(const FlatAst& ast, NodeIndex root, Visitor& visitor, std::vector<FlatFrame>& stack) {
+    size_t base = stack.size();
+    auto enter = [&](NodeIndex node) {
+        switch (ast.kinds[node]) {
+            case FlatKind::BLOCK:
+                visitor.enterBlock(node);
+                stack.push_back(FlatFrame{node, 0});
+                break;
+            case FlatKind::IF:
+                visitor.enterIf(node);
+                stack.push_back(FlatFrame{node, 0});
+                visitor.enterBlock(ast.ifs[ast.a[node]].thenBlock);
+                stack.push_back(FlatFrame{ast.ifs[ast.a[node]].thenBlock, 0});
+                break;
+            default:
+                visitor.statement(node);
+                break;
+        }
+    };
+    enter(root);
+    while (stack.size() > base) {
+        FlatFrame& frame = stack.back();
+        NodeIndex node = frame.node;
+        if (ast.kinds[node] == FlatKind::BLOCK) {
+            if (frame.step < ast.b[node]) {
+                enter(ast.blockBegin(node)[frame.step++]);
+            } else {
+                stack.pop_back();
+                visitor.exitBlock(node);
+            }
+        } else if (frame.step == 0) {
+            frame.step = 1;
+            visitor.beforeElse(node);
+            if (ast.ifs[ast.a[node]].elseBlock != kNoNode) {
+                enter(ast.ifs[ast.a[node]].elseBlock);
+            }
+        } else {
+            stack.pop_back();
+            visitor.exitIf(node);
+        }
+    }
+}
+
+//Appends nodes to a FlatAst; the Parser drives it while parsing
+class FlatAstBuilder {
+public:
+    using Expr = FlatExpression;
+    using Stmt = NodeIndex;
+
+    explicit FlatAstBuilder(FlatAst& ast) : ast(ast) {}
+
+    Expr stringLiteral(std::string_view value, SourceOffset offset);
+    Expr numberLiteral(int value, SourceOffset offset);
+    Expr identifier(SymbolId name, SourceOffset offset);
+    Expr binary(Expr left, BinaryOperator op, Expr right, SourceOffset offset);
+
+    Stmt block(const Stmt* statements, size_t count, SourceOffset offset);
+    Stmt ifStatement(Expr condition, Stmt thenBlock, Stmt elseBlock, SourceOffset offset);
+    Stmt noBlock() const { return kNoNode; }
+    Stmt variableDeclaration(SymbolId name, Expr value, SourceOffset offset);
+    Stmt showStatement(Expr expression, SourceOffset offset);
+    Stmt assignmentStatement(SymbolId name, Expr value, SourceOffset offset);
+
+    void addTopLevel(Stmt statement) { ast.statements.push_back(statement); }
+
+private:
+    FlatAst& ast;
+
+    NodeIndex add(FlatKind kind, uint32_t a, uint32_t b, uint32_t c, SourceOffset offset);
+};
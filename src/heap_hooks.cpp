@@ -0,0 +1,32 @@
+//
+//The driver's replacement operator new and delete, which feed heap_profile
+//while it is active. Only gehu links this; gehu_bench counts on its own
+//The nothrow forms call these; the aligned forms keep the library's and
+//go unprofiled
+#include "heap_profile.hpp"
+#include <cstdlib>
+#include <new>
+
+void* operator new(size_t size) {
+    void* block = std::malloc(size ? size : 1);
+    if (!block) {
+        throw std::bad_alloc();
+    }
+    if (heap_profile::active.load(std::memory_order_relaxed)) {
+        heap_profile::allocated(block, size);
+    }
+    return block;
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+
+void operator delete(void* block) noexcept {
+    if (block && heap_profile::active.load(std::memory_order_relaxed)) {
+        heap_profile::freed(block);
+    }
+    std::free(block);
+}
+
+void operator delete[](void* block) noexcept { operator delete(block); }
+void operator delete(void* block, size_t) noexcept { operator delete(block); }
+void operator delete[](void* block, size_t) noexcept { operator delete(block); }
@@ -0,0 +1,67 @@
+#include "heap_profile.hpp"
+#include <malloc.h> //for malloc_usable_size
+
+namespace heap_profile {
+
+namespace {
+
+// Nothing here may allocate: it runs inside operator new
+struct Slot {
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> frees{0};
+    std::atomic<int64_t> net{0};
+    std::atomic<int64_t> peak{0};
+};
+
+Slot slots[kSlots];
+std::atomic<size_t> current{kOutside};
+std::atomic<int64_t> live{0};
+
+void raisePeak(Slot& slot, int64_t bytes) {
+    int64_t peak = slot.peak.load(std::memory_order_relaxed);
+    while (bytes > peak && !slot.peak.compare_exchange_weak(peak, bytes, std::memory_order_relaxed)) {
+    }
+}
+
+} // namespace
+
+void enable() {
+    active.store(true, std::memory_order_relaxed);
+}
+
+size_t enter(size_t slot) {
+    size_t previous = current.exchange(slot, std::memory_order_relaxed);
+    raisePeak(slots[slot], live.load(std::memory_order_relaxed));
+    return previous;
+}
+
+void allocated(void* block, size_t size) {
+    int64_t usable = static_cast<int64_t>(malloc_usable_size(block));
+    Slot& slot = slots[current.load(std::memory_order_relaxed)];
+    slot.allocations.fetch_add(1, std::memory_order_relaxed);
+    slot.bytes.fetch_add(size, std::memory_order_relaxed);
+    slot.net.fetch_add(usable, std::memory_order_relaxed);
+    raisePeak(slot, live.fetch_add(usable, std::memory_order_relaxed) + usable);
+}
+
+void freed(void* block) {
+    int64_t usable = static_cast<int64_t>(malloc_usable_size(block));
+    Slot& slot = slots[current.load(std::memory_order_relaxed)];
+    slot.frees.fetch_add(1, std::memory_order_relaxed);
+    slot.net.fetch_sub(usable, std::memory_order_relaxed);
+    live.fetch_sub(usable, std::memory_order_relaxed);
+}
+
+Counters counters(size_t slot) {
+    const Slot& from = slots[slot];
+    Counters result;
+    result.allocations = from.allocations.load(std::memory_order_relaxed);
+    result.bytes = from.bytes.load(std::memory_order_relaxed);
+    result.frees = from.frees.load(std::memory_order_relaxed);
+    result.net = from.net.load(std::memory_order_relaxed);
+    result.peak = from.peak.load(std::memory_order_relaxed);
+    return result;
+}
+
+} // namespace heap_profile
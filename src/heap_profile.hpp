@@ -0,0 +1,37 @@
+//
+//Heap profile: heap allocations attributed to the compiler phases
+//The driver's operator new and delete (heap_hooks.cpp) report every block
+//here while profiling is on, and each PhaseTimer makes its phase current
+//A free counts against the phase that makes it, not the one that allocated
+//the block. Live bytes are counted from enable() in the allocator's block
+//sizes; what LLVM takes from malloc directly only shows in the RSS
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace heap_profile {
+
+constexpr size_t kSlots = 16; // one per phase, the last for kOutside
+constexpr size_t kOutside = kSlots - 1; // allocations made outside every phase
+
+struct Counters {
+    uint64_t allocations = 0;
+    uint64_t bytes = 0; // as requested
+    uint64_t frees = 0;
+    int64_t net = 0; // block bytes allocated minus block bytes freed
+    int64_t peak = 0; // most live bytes while the slot was current
+};
+
+// Checked by the hooks before every call below
+inline std::atomic<bool> active{false};
+
+void enable();
+// Makes slot current and returns the slot that was
+size_t enter(size_t slot);
+void allocated(void* block, size_t size);
+void freed(void* block);
+Counters counters(size_t slot);
+
+} // namespace heap_profile
@@ -0,0 +1,268 @@
+#include "incremental.hpp"
+#include "ast_visitor.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+//Moves every offset in a statement's subtree by delta
+class OffsetShifter : public ASTVisitor<OffsetShifter> {
+public:
+    explicit OffsetShifter(int64_t delta) : delta(delta) {}
+
+    void visitStringLiteral(StringLiteral* node) { shift(node); }
+    void visitNumberLiteral(NumberLiteral* node) { shift(node); }
+    void visitIdentifier(Identifier* node) { shift(node); }
+    void visitBinaryExpression(BinaryExpression* node) { shift(node); }
+    bool enterBlock(Block* node) { return shift(node); }
+    bool enterIfStatement(IfStatement* node) { return shift(node); }
+    bool enterVariableDeclaration(VariableDeclaration* node) { return shift(node); }
+    bool enterShowStatement(ShowStatement* node) { return shift(node); }
+    bool enterAssignmentStatement(AssignmentStatement* node) { return shift(node); }
+
+private:
+    int64_t delta;
+
+    template <typename Node>
+    bool shift(Node* node) {
+        node->offset = static_cast<SourceOffset>(node->offset + delta);
+        return true;
+    }
+};
+
+//Index of the segment that offset falls in, given the segments' begins
+size_t segmentOf(const std::vector<SourceOffset>& begins, SourceOffset offset) {
+    size_t after = std::upper_bound(begins.begin(), begins.end(), offset) - begins.begin();
+    return after == 0 ? 0 : after - 1;
+}
+
+} // namespace
+
+IncrementalFrontend::IncrementalFrontend(std::string source) : source(std::move(source)), analyzer(symbols) {
+    reparse(0, 0, 0, 0);
+    analyze();
+    collectDiagnostics();
+}
+
+Program* IncrementalFrontend::getProgram() {
+    return lexErrors.empty() && syntaxErrors.empty() ? &program : nullptr;
+}
+
+void IncrementalFrontend::edit(std::vector<SourceEdit> edits) {
+    if (edits.empty()) {
+        return;
+    }
+    std::stable_sort(edits.begin(), edits.end(),
+                     [](const SourceEdit& a, const SourceEdit& b) { return a.offset < b.offset; });
+    size_t end = 0;
+    for (const SourceEdit& edit : edits) {
+        if (edit.offset < end || edit.offset > source.size() || edit.length > source.size() - edit.offset) {
+            throw std::runtime_error("Source edits overlap or run past the end of the source");
+        }
+        end = edit.offset + edit.length;
+    }
+    SourceOffset lo = edits.front().offset;
+    SourceOffset hi = static_cast<SourceOffset>(end);
+    int64_t delta = 0;
+    // Back to front, so the offsets of the edits still to come stay valid
+    for (auto edit = edits.rbegin(); edit != edits.rend(); ++edit) {
+        source.replace(edit->offset, edit->length, edit->text);
+        delta += static_cast<int64_t>(edit->text.size()) - static_cast<int64_t>(edit->length);
+    }
+
+    // Reparsing starts at the segment before the one lo falls in: the edit
+    // may extend that segment, or turn the first token of lo's segment into
+    // or out of else and so move the boundary after the previous one's }
+    size_t containing = std::upper_bound(segments.begin(), segments.end(), lo,
+                                         [](SourceOffset offset, const Segment& segment) { return offset < segment.begin; }) -
+                        segments.begin();
+    size_t first = containing < 2 ? 0 : containing - 2;
+    SourceOffset start = first == 0 ? 0 : segments[first].begin;
+    reparse(first, start, hi, delta);
+    analyze();
+    collectDiagnostics();
+}
+
+//Relexes from start, cutting segments as ParallelParser cuts ranges, until
+//a segment starts where an old one after the edits started (moved by delta),
+//then parses the new segments and puts them in place of segments
+//[first, that one). Without a lexical error to stop it, the scan that finds
+//no such segment runs to the end of the source
+void IncrementalFrontend::reparse(size_t first, SourceOffset start, SourceOffset editEnd, int64_t delta) {
+    // Segments after a lexical error were never made, so none is left to meet
+    bool canResync = lexErrors.empty();
+    lexErrors.clear();
+    analyzedPrefix = std::min(analyzedPrefix, first);
+    size_t reusable = std::lower_bound(segments.begin() + first, segments.end(), editEnd,
+                                       [](const Segment& segment, SourceOffset offset) { return segment.begin < offset; }) -
+                      segments.begin();
+    size_t resync = segments.size();
+    std::vector<Token> tokens;
+    std::vector<SourceOffset> begins;
+    Token eof;
+    try {
+        Lexer lexer(source, symbols);
+        lexer.setPosition(start);
+        Token token = lexer.nextToken();
+        bool atStart = true;
+        size_t depth = 0;
+        while (token.type != TokenType::EOF_TOKEN) {
+            if (atStart) {
+                int64_t old = static_cast<int64_t>(token.offset) - delta;
+                if (canResync && old >= editEnd) {
+                    auto match = std::lower_bound(segments.begin() + reusable, segments.end(), old,
+                                                  [](const Segment& segment, int64_t offset) { return segment.begin < offset; });
+                    if (match != segments.end() && match->begin == old) {
+                        resync = match - segments.begin();
+                        break;
+                    }
+                }
+                begins.push_back(token.offset);
+            }
+            tokens.push_back(token);
+            Token following = lexer.nextToken();
+            bool boundary = false;
+            switch (token.type) {
+                case TokenType::LEFT_BRACE:
+                    ++depth;
+                    break;
+                case TokenType::RIGHT_BRACE:
+                    if (depth > 0) {
+                        --depth;
+                    }
+                    boundary = depth == 0 && following.type != TokenType::ELSE;
+                    break;
+                case TokenType::SEMICOLON:
+                    boundary = depth == 0;
+                    break;
+                default:
+                    break;
+            }
+            atStart = boundary;
+            token = following;
+        }
+        eof = Token(TokenType::EOF_TOKEN, "", token.offset);
+    } catch (const LexerError& error) {
+        // The driver reports a lexical error on its own, so nothing after
+        // the edit is parsed until it is fixed
+        lexErrors.push_back(error);
+        SourceOffset cut = first < segments.size() ? segments[first].begin : 0;
+        syntaxErrors.erase(std::lower_bound(syntaxErrors.begin(), syntaxErrors.end(), cut,
+                                            [](const SyntaxError& e, SourceOffset offset) { return e.segment < offset; }),
+                           syntaxErrors.end());
+        segments.resize(first);
+        lastReparsed = 0;
+        program.statements.clear();
+        for (const Segment& segment : segments) {
+            if (segment.statement) {
+                program.statements.push_back(segment.statement);
+            }
+        }
+        return;
+    }
+
+    // Errors stay unlimited here; the limit is applied when they are reported
+    std::vector<Segment> replacement(begins.size());
+    std::vector<SyntaxError> found;
+    if (!tokens.empty()) {
+        Parser parser(tokens.data(), tokens.size(), eof);
+        parser.setErrorLimit(0);
+        std::vector<CompilerError> errors;
+        auto piece = parser.parseRecovering(errors);
+        for (size_t i = 0; i < begins.size(); ++i) {
+            replacement[i] = Segment{begins[i], nullptr};
+        }
+        // Without errors every segment holds exactly one statement
+        for (Statement* statement : piece->statements) {
+            Segment& segment = replacement[segmentOf(begins, statement->offset)];
+            if (!segment.statement) {
+                segment.statement = statement;
+            }
+        }
+        for (const CompilerError& error : errors) {
+            found.push_back(SyntaxError{begins[segmentOf(begins, error.getOffset())], error});
+        }
+        program.arena.adopt(std::move(piece->arena));
+    }
+
+    // Everything from resync on keeps its subtree, moved by delta
+    SourceOffset oldBegin = first < segments.size() ? segments[first].begin : 0;
+    SourceOffset oldEnd = resync < segments.size() ? segments[resync].begin : std::numeric_limits<SourceOffset>::max();
+    auto bySegment = [](const SyntaxError& e, SourceOffset offset) { return e.segment < offset; };
+    size_t errorsFrom = std::lower_bound(syntaxErrors.begin(), syntaxErrors.end(), oldBegin, bySegment) - syntaxErrors.begin();
+    size_t errorsTo = std::lower_bound(syntaxErrors.begin(), syntaxErrors.end(), oldEnd, bySegment) - syntaxErrors.begin();
+    if (delta != 0) {
+        OffsetShifter shifter(delta);
+        for (size_t i = resync; i < segments.size(); ++i) {
+            segments[i].begin = static_cast<SourceOffset>(segments[i].begin + delta);
+            if (segments[i].statement) {
+                shifter.walk(segments[i].statement);
+            }
+        }
+        for (size_t i = errorsTo; i < syntaxErrors.size(); ++i) {
+            SyntaxError& e = syntaxErrors[i];
+            e.segment = static_cast<SourceOffset>(e.segment + delta);
+            if (e.error.hasLocation()) {
+                e.error = CompilerError(e.error.what(), static_cast<SourceOffset>(e.error.getOffset() + delta));
+            }
+        }
+    }
+    syntaxErrors.erase(syntaxErrors.begin() + errorsFrom, syntaxErrors.begin() + errorsTo);
+    syntaxErrors.insert(syntaxErrors.begin() + errorsFrom, found.begin(), found.end());
+    segments.erase(segments.begin() + first, segments.begin() + resync);
+    segments.insert(segments.begin() + first, replacement.begin(), replacement.end());
+    lastReparsed = replacement.size();
+
+    program.statements.clear();
+    program.statements.reserve(segments.size());
+    for (const Segment& segment : segments) {
+        if (segment.statement) {
+            program.statements.push_back(segment.statement);
+        }
+    }
+}
+
+//Statements before analyzedPrefix are the ones the analyzer saw last time,
+//so it resumes from there
+void IncrementalFrontend::analyze() {
+    lastReanalyzed = 0;
+    if (!getProgram()) {
+        return;
+    }
+    analyzer.setErrorLimit(errorLimit);
+    lastReanalyzed = program.statements.size() - std::min(analyzedPrefix, program.statements.size());
+    semanticErrors.clear();
+    semanticTruncated = false;
+    try {
+        analyzer.reanalyze(&program, analyzedPrefix);
+    } catch (const CompilerErrorList& list) {
+        semanticErrors = list.getErrors();
+        semanticTruncated = list.isTruncated();
+    }
+    analyzedPrefix = program.statements.size();
+}
+
+void IncrementalFrontend::collectDiagnostics() {
+    diagnostics.clear();
+    truncated = false;
+    if (!lexErrors.empty()) {
+        diagnostics = lexErrors;
+    } else if (!syntaxErrors.empty()) {
+        // The Parser gives up once it has found errorLimit errors
+        size_t count = syntaxErrors.size();
+        if (errorLimit != 0 && count >= errorLimit) {
+            count = errorLimit;
+            truncated = true;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            diagnostics.push_back(syntaxErrors[i].error);
+        }
+    } else {
+        diagnostics = semanticErrors;
+        truncated = semanticTruncated;
+    }
+}
@@ -0,0 +1,91 @@
+//
+//IncrementalFrontend: keeps a source, its Program and its diagnostics up to
+//date across edits without rerunning the whole front end
+//The source is cut into segments at top-level statement boundaries (the
+//rule ParallelParser uses), and each segment holds the one top-level
+//statement parsed from it, or none when it has syntax errors. An edit is
+//relexed and reparsed from the segment it touches until the new segments
+//line up with old ones again; every other segment keeps its subtree, moved
+//by the edit's length change. Semantic analysis is then redone from the
+//first changed statement on (see SemanticAnalyzer::reanalyze)
+//Subtrees of replaced statements stay in the Program's arena until the
+//frontend is rebuilt
+#pragma once
+
+#include "ast.hpp"
+#include "errors.hpp"
+#include "interner.hpp"
+#include "semantic_analyzer.hpp"
+#include "source_location.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//Replaces length bytes at offset with text
+struct SourceEdit {
+    SourceOffset offset;
+    SourceOffset length;
+    std::string text;
+};
+
+class IncrementalFrontend {
+public:
+    // Lexes, parses and analyzes source in full
+    explicit IncrementalFrontend(std::string source);
+    IncrementalFrontend(const IncrementalFrontend&) = delete;
+    IncrementalFrontend& operator=(const IncrementalFrontend&) = delete;
+
+    // Applies edits at once; their offsets refer to the source before any of
+    // them, and they must not overlap. Throws std::runtime_error otherwise
+    void edit(std::vector<SourceEdit> edits);
+
+    const std::string& text() const { return source; }
+    const StringInterner& getSymbols() const { return symbols; }
+    // Null while the source has lexical or syntax errors
+    Program* getProgram();
+    // Errors of the first phase that failed, as the driver would report them
+    const std::vector<CompilerError>& getDiagnostics() const { return diagnostics; }
+    bool diagnosticsTruncated() const { return truncated; }
+
+    // Errors reported per phase; 0 means no limit. Takes effect at the next edit
+    void setErrorLimit(size_t limit) {
+        errorLimit = limit;
+        analyzedPrefix = 0;
+    }
+
+    // Work done by the last edit, in top-level statements
+    size_t reparsedStatements() const { return lastReparsed; }
+    size_t reanalyzedStatements() const { return lastReanalyzed; }
+
+private:
+    struct Segment {
+        SourceOffset begin; // first token
+        Statement* statement; // first statement parsed from it, if any
+    };
+
+    struct SyntaxError {
+        SourceOffset segment; // begin of the segment it was found in
+        CompilerError error;
+    };
+
+    std::string source;
+    StringInterner symbols;
+    Program program;
+    std::vector<Segment> segments;
+    std::vector<CompilerError> lexErrors; // the lexer stops at its first error; no segments follow it
+    std::vector<SyntaxError> syntaxErrors; // in source order
+    SemanticAnalyzer analyzer;
+    std::vector<CompilerError> semanticErrors;
+    bool semanticTruncated = false;
+    size_t analyzedPrefix = 0; // leading statements unchanged since the last analysis
+    size_t errorLimit = ErrorCollector::kDefaultLimit;
+    std::vector<CompilerError> diagnostics;
+    bool truncated = false;
+    size_t lastReparsed = 0;
+    size_t lastReanalyzed = 0;
+
+    void reparse(size_t first, SourceOffset start, SourceOffset editEnd, int64_t delta);
+    void analyze();
+    void collectDiagnostics();
+};
@@ -0,0 +1,45 @@
+#include "interner.hpp"
+#include <algorithm>
+#include <cstring>
+
+SymbolId StringInterner::intern(std::string_view text) {
+    if (ids.size() < names.size()) {
+        indexAppended();
+    }
+    auto it = ids.find(text);
+    if (it != ids.end()) {
+        return it->second;
+    }
+    std::string_view stored = store(text);
+    SymbolId id = static_cast<SymbolId>(names.size());
+    names.push_back(stored);
+    ids.emplace(stored, id);
+    return id;
+}
+
+SymbolId StringInterner::append(std::string_view text) {
+    SymbolId id = static_cast<SymbolId>(names.size());
+    names.push_back(store(text));
+    return id;
+}
+
+void StringInterner::indexAppended() {
+    ids.reserve(names.size());
+    for (SymbolId id = static_cast<SymbolId>(ids.size()); id < names.size(); ++id) {
+        ids.emplace(names[id], id);
+    }
+}
+
+std::string_view StringInterner::store(std::string_view text) {
+    if (text.size() > remaining) {
+        size_t capacity = std::max(text.size(), kChunkSize);
+        chunks.emplace_back(new char[capacity]);
+        cursor = chunks.back().get();
+        remaining = capacity;
+    }
+    std::memcpy(cursor, text.data(), text.size());
+    std::string_view stored(cursor, text.size());
+    cursor += text.size();
+    remaining -= text.size();
+    return stored;
+}
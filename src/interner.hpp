@@ -0,0 +1,44 @@
+//
+//StringInterner class definition
+//Every identifier is interned once by the Lexer and gets a dense SymbolId
+//Later phases key their tables on SymbolId, so a lookup is a vector index
+//The interner owns the name bytes; views it returns live as long as it does
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using SymbolId = uint32_t;
+constexpr SymbolId kInvalidSymbol = UINT32_MAX;
+
+class StringInterner {
+public:
+    StringInterner() = default;
+    StringInterner(const StringInterner&) = delete;
+    StringInterner& operator=(const StringInterner&) = delete;
+
+    // Returns the id of text, assigning the next free id on first sight
+    SymbolId intern(std::string_view text);
+    std::string_view name(SymbolId id) const { return names[id]; }
+    // Gives text the next free id without looking it up; text must not have
+    // been interned yet. For restoring a saved symbol table in id order: the
+    // lookup index only catches up on the next intern()
+    SymbolId append(std::string_view text);
+    // Number of distinct symbols; every id is below this
+    size_t size() const { return names.size(); }
+
+private:
+    static constexpr size_t kChunkSize = 64 * 1024;
+
+    std::unordered_map<std::string_view, SymbolId> ids; // keys view into chunks
+    std::vector<std::string_view> names;
+    std::vector<std::unique_ptr<char[]>> chunks;
+    char* cursor = nullptr; // free space in the newest chunk
+    size_t remaining = 0;
+
+    std::string_view store(std::string_view text);
+    void indexAppended();
+};
@@ -1,129 +1,68 @@
 #include "lexer.hpp"
 #include "errors.hpp" //for LexerError
-#include <cctype> //for isalpha, isdigit
-#include <iostream>
+#include "lexer_tables.hpp" //for the character class, operator and keyword tables
+#include "log.hpp"
 
 //Lexer class constructor
-Lexer::Lexer(const std::string& source)
-    : source(source), position(0), line(1), column(1) {}
+Lexer::Lexer(std::string_view source, StringInterner& symbols)
+    : source(source), symbols(symbols), position(0), kernels(lexer_simd::active()) {
+    if (source.size() > kMaxSourceSize) {
+        throw LexerError("Source is too large (limit is 4 GiB)", kNoOffset);
+    }
+}
 
 Token Lexer::nextToken() {
-    skipWhitespace();
-    
-    if (position >= source.length()) {
-        return makeToken(TokenType::EOF_TOKEN, "");
-    }
+    using lexer_tables::CharClass;
     
-    // Skip comments
-    if (current() == '/' && position + 1 < source.length() && source[position + 1] == '/') {
-        // Skip until end of line
-        while (position < source.length() && current() != '\n') {
-            advance();
-        }
+    // Loops only to skip comments; every other class produces a token
+    while (true) {
         skipWhitespace();
+        
         if (position >= source.length()) {
-            return makeToken(TokenType::EOF_TOKEN, "");
-        }
-    }
-    
-    char c = current();
-    
-    if (isalpha(c)) {
-        return scanIdentifier();
-    }
-    
-    if (isdigit(c)) {
-        return scanNumber();
-    }
-    
-    if (c == '"') {
-        return scanString();
-    }
-    
-    if (c == '=') {
-        advance();
-        if (current() == '=') {
-            advance();
-            return makeToken(TokenType::EQUAL_EQUAL, "==");
+            return makeToken(TokenType::EOF_TOKEN, "", position);
         }
-        return makeToken(TokenType::EQUALS, "=");
-    }
-    
-    if (c == '!') {
-        advance();
-        if (current() == '=') {
-            advance();
-            return makeToken(TokenType::NOT_EQUAL, "!=");
-        }
-        throw LexerError("Expected '=' after '!'", line, column - 1);
-    }
-    
-    if (c == '>') {
-        advance();
-        if (current() == '=') {
-            advance();
-            return makeToken(TokenType::GREATER_EQUAL, ">=");
-        }
-        return makeToken(TokenType::GREATER_THAN, ">");
-    }
-    
-    if (c == '<') {
-        advance();
-        if (current() == '=') {
-            advance();
-            return makeToken(TokenType::LESS_EQUAL, "<=");
+        
+        unsigned char c = static_cast<unsigned char>(source[position]);
+        switch (lexer_tables::charClasses[c]) {
+            case CharClass::IDENTIFIER_START:
+                return scanIdentifier();
+            case CharClass::DIGIT:
+                return scanNumber();
+            case CharClass::QUOTE:
+                return scanString();
+            case CharClass::SLASH:
+                if (position + 1 < source.length() && source[position + 1] == '/') {
+                    // Skip until end of line
+                    const char* begin = source.data();
+                    position = kernels.findNewline(begin + position, begin + source.length()) - begin;
+                    continue;
+                }
+                return scanOperator();
+            case CharClass::OPERATOR:
+                return scanOperator();
+            case CharClass::WHITESPACE:
+            case CharClass::INVALID:
+                break;
         }
-        return makeToken(TokenType::LESS_THAN, "<");
-    }
-    
-    if (c == ';') {
-        advance();
-        return makeToken(TokenType::SEMICOLON, ";");
-    }
-    
-    if (c == '+') {
-        advance();
-        return makeToken(TokenType::PLUS, "+");
-    }
-    
-    if (c == '-') {
-        advance();
-        return makeToken(TokenType::MINUS, "-");
-    }
-    
-    if (c == '*') {
-        advance();
-        return makeToken(TokenType::MULTIPLY, "*");
-    }
-    
-    if (c == '/') {
-        advance();
-        return makeToken(TokenType::DIVIDE, "/");
-    }
-    
-    if (c == '{') {
-        advance();
-        return makeToken(TokenType::LEFT_BRACE, "{");
-    }
-    
-    if (c == '}') {
-        advance();
-        return makeToken(TokenType::RIGHT_BRACE, "}");
+        
+        // Invalid character
+        throw LexerError("Unexpected character: " + std::string(1, source[position]), static_cast<SourceOffset>(position));
     }
+}
+
+Token Lexer::scanOperator() {
+    size_t start = position;
+    const lexer_tables::OperatorTransition& transition =
+        lexer_tables::operatorTransitions[static_cast<unsigned char>(advance())];
     
-    if (c == '(') {
+    if (transition.withEquals != TokenType::ERROR && current() == '=') {
         advance();
-        return makeToken(TokenType::LEFT_PAREN, "(");
+        return makeToken(transition.withEquals, source.substr(start, 2), start);
     }
-    
-    if (c == ')') {
-        advance();
-        return makeToken(TokenType::RIGHT_PAREN, ")");
+    if (transition.alone == TokenType::ERROR) {
+        throw LexerError("Expected '=' after '" + std::string(1, source[start]) + "'", static_cast<SourceOffset>(start));
     }
-    
-    // Invalid character
-    char invalid = advance();
-    throw LexerError("Unexpected character: " + std::string(1, invalid), line, column - 1);
+    return makeToken(transition.alone, source.substr(start, 1), start);
 }
 
 bool Lexer::hasNext() const {
@@ -137,87 +76,58 @@ char Lexer::current() const {
 char Lexer::advance() {
     char c = current();
     position++;
-    column++;
     return c;
 }
 
 void Lexer::skipWhitespace() {
-    while (position < source.length()) {
-        char c = current();
-        if (c == ' ' || c == '\t') {
-            advance();
-            continue;
-        }
-        if (c == '\n') {
-            advance();
-            line++;
-            column = 1;
-            continue;
-        }
-        break;
-    }
+    const char* begin = source.data();
+    position = kernels.skipWhitespace(begin + position, begin + source.length()) - begin;
 }
 
-Token Lexer::makeToken(TokenType type, const std::string& value) {
-    Token token(type, value, line, column);
-    std::cout << "[Lexer] Token: " << value << " (Type: " << static_cast<int>(type) << ")" << std::endl;
+Token Lexer::makeToken(TokenType type, std::string_view value, size_t start) {
+    Token token(type, value, static_cast<SourceOffset>(start));
+    ++produced;
+    GEHU_LOG(LEXER, TRACE, "Token: " << value << " (Type: " << static_cast<int>(type) << ")");
     return token;
 }
 
 Token Lexer::scanIdentifier() {
     size_t start = position;
-    while (position < source.length() && (isalnum(current()) || current() == '_')) {
-        advance();
-    }
+    const char* begin = source.data();
+    position = kernels.skipIdentifier(begin + position, begin + source.length()) - begin;
     
-    std::string text = source.substr(start, position - start);
-    
-    if (text == "let") {
-        return makeToken(TokenType::LET, text);
-    }
-    if (text == "show") {
-        return makeToken(TokenType::SHOW, text);
+    std::string_view text = source.substr(start, position - start);
+    TokenType type = lexer_tables::classifyWord(text);
+    Token token = makeToken(type, text, start);
+    if (type == TokenType::IDENTIFIER) {
+        token.symbol = symbols.intern(text);
     }
-    if (text == "if") {
-        return makeToken(TokenType::IF, text);
-    }
-    if (text == "else") {
-        return makeToken(TokenType::ELSE, text);
-    }
-    
-    return makeToken(TokenType::IDENTIFIER, text);
+    return token;
 }
 
 Token Lexer::scanNumber() {
     size_t start = position;
-    while (position < source.length() && isdigit(current())) {
-        advance();
-    }
+    const char* begin = source.data();
+    position = kernels.skipDigits(begin + position, begin + source.length()) - begin;
     
-    std::string text = source.substr(start, position - start);
-    return makeToken(TokenType::NUMBER_LITERAL, text);
+    std::string_view text = source.substr(start, position - start);
+    return makeToken(TokenType::NUMBER_LITERAL, text, start);
 }
 
 Token Lexer::scanString() {
+    size_t quote = position;
     advance(); // Skip opening quote
     size_t start = position;
-    size_t startLine = line;
-    size_t startColumn = column;
     
-    while (position < source.length() && current() != '"') {
-        if (current() == '\n') {
-            line++;
-            column = 1;
-        }
-        advance();
-    }
+    const char* begin = source.data();
+    position = kernels.findQuote(begin + position, begin + source.length()) - begin;
     
     if (position >= source.length()) {
-        throw LexerError("Unterminated string literal", startLine, startColumn);
+        throw LexerError("Unterminated string literal", static_cast<SourceOffset>(quote));
     }
     
-    std::string text = source.substr(start, position - start);
+    std::string_view text = source.substr(start, position - start);
     advance(); // Skip closing quote
     
-    return makeToken(TokenType::STRING_LITERAL, text);
+    return makeToken(TokenType::STRING_LITERAL, text, quote);
 } 
\ No newline at end of file
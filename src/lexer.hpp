@@ -10,7 +10,11 @@
 
 #pragma once
 
+#include "interner.hpp"
+#include "lexer_simd.hpp"
+#include "source_location.hpp"
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 
@@ -51,18 +55,21 @@ enum class TokenType {
     ERROR
 };
 
+//Token value is a view into the Lexer's source buffer, which must outlive it
+//IDENTIFIER tokens also carry the interned SymbolId of their text
+//offset is where the token starts (the opening quote for strings)
 struct Token {
     TokenType type;
-    std::string value;
-    size_t line;
-    size_t column;
+    std::string_view value;
+    SymbolId symbol;
+    SourceOffset offset;
     
     // Default constructor
-    Token() : type(TokenType::ERROR), line(0), column(0) {}
+    Token() : type(TokenType::ERROR), symbol(kInvalidSymbol), offset(kNoOffset) {}
     
     // Parameterized constructor
-    Token(TokenType t, const std::string& v, size_t l, size_t c)
-        : type(t), value(v), line(l), column(c) {}
+    Token(TokenType t, std::string_view v, SourceOffset o)
+        : type(t), value(v), symbol(kInvalidSymbol), offset(o) {}
 };
 
 //Lexer class
@@ -75,20 +82,29 @@ struct Token {
 //It also handles errors
 class Lexer {
 public:
-    explicit Lexer(const std::string& source);
+    // source must outlive the Lexer; it is viewed, never copied
+    // Identifiers are interned into symbols
+    // Throws LexerError when source is too large for 32-bit offsets
+    Lexer(std::string_view source, StringInterner& symbols);
     Token nextToken();
     bool hasNext() const;
+    // Continues lexing from offset, which must not be inside a token, string or comment
+    void setPosition(size_t offset) { position = offset; }
+    // Tokens returned so far, EOF_TOKEN included
+    size_t tokenCount() const { return produced; }
     
 private:
-    std::string source;
+    std::string_view source;
+    StringInterner& symbols;
     size_t position;
-    size_t line;
-    size_t column;
+    size_t produced = 0;
+    const lexer_simd::Kernels& kernels;
     
     char current() const;
     char advance();
     void skipWhitespace();
-    Token makeToken(TokenType type, const std::string& value);
+    Token makeToken(TokenType type, std::string_view value, size_t start);
+    Token scanOperator();
     Token scanIdentifier();
     Token scanString();
     Token scanNumber();
@@ -0,0 +1,448 @@
+#include "lexer_simd.hpp"
+#include <atomic>
+#include <cstdint>
+#include <initializer_list>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define GEHU_LEXER_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+namespace lexer_simd {
+namespace {
+
+// ---------------------------------------------------------------------------
+// Scalar kernels: the reference behaviour and the tail of every vector kernel
+// ---------------------------------------------------------------------------
+
+inline bool isIdentifierChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+const char* scalarSkipWhitespace(const char* p, const char* end) {
+    while (p < end) {
+        char c = *p;
+        if (c != ' ' && c != '\t' && c != '\n') {
+            break;
+        }
+        ++p;
+    }
+    return p;
+}
+
+const char* scalarSkipIdentifier(const char* p, const char* end) {
+    while (p < end && isIdentifierChar(*p)) {
+        ++p;
+    }
+    return p;
+}
+
+const char* scalarSkipDigits(const char* p, const char* end) {
+    while (p < end && *p >= '0' && *p <= '9') {
+        ++p;
+    }
+    return p;
+}
+
+const char* scalarFindQuote(const char* p, const char* end) {
+    while (p < end && *p != '"') {
+        ++p;
+    }
+    return p;
+}
+
+const char* scalarFindNewline(const char* p, const char* end) {
+    while (p < end && *p != '\n') {
+        ++p;
+    }
+    return p;
+}
+
+const char* scalarFindQuoteOrSlash(const char* p, const char* end) {
+    while (p < end && *p != '"' && *p != '/') {
+        ++p;
+    }
+    return p;
+}
+
+const Kernels scalarKernels = {
+    Isa::SCALAR,
+    scalarSkipWhitespace,
+    scalarSkipIdentifier,
+    scalarSkipDigits,
+    scalarFindQuote,
+    scalarFindNewline,
+    scalarFindQuoteOrSlash,
+};
+
+#ifdef GEHU_LEXER_SIMD_X86
+
+// ---------------------------------------------------------------------------
+// SSE4.2: PCMPESTRI classifies 16 bytes against a set or a list of ranges
+// ---------------------------------------------------------------------------
+
+#define GEHU_SSE42 __attribute__((target("sse4.2,popcnt")))
+
+constexpr int kFirstMismatch = _SIDD_UBYTE_OPS | _SIDD_NEGATIVE_POLARITY | _SIDD_LEAST_SIGNIFICANT;
+
+GEHU_SSE42 const char* sse42SkipWhitespace(const char* p, const char* end) {
+    const __m128i set = _mm_setr_epi8(' ', '\t', '\n', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int index = _mm_cmpestri(set, 3, chunk, 16, kFirstMismatch | _SIDD_CMP_EQUAL_ANY);
+        if (index < 16) {
+            return p + index;
+        }
+        p += 16;
+    }
+    return scalarSkipWhitespace(p, end);
+}
+
+GEHU_SSE42 const char* sse42SkipIdentifier(const char* p, const char* end) {
+    const __m128i ranges = _mm_setr_epi8('a', 'z', 'A', 'Z', '0', '9', '_', '_', 0, 0, 0, 0, 0, 0, 0, 0);
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int index = _mm_cmpestri(ranges, 8, chunk, 16, kFirstMismatch | _SIDD_CMP_RANGES);
+        if (index < 16) {
+            return p + index;
+        }
+        p += 16;
+    }
+    return scalarSkipIdentifier(p, end);
+}
+
+GEHU_SSE42 const char* sse42SkipDigits(const char* p, const char* end) {
+    const __m128i ranges = _mm_setr_epi8('0', '9', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int index = _mm_cmpestri(ranges, 2, chunk, 16, kFirstMismatch | _SIDD_CMP_RANGES);
+        if (index < 16) {
+            return p + index;
+        }
+        p += 16;
+    }
+    return scalarSkipDigits(p, end);
+}
+
+GEHU_SSE42 const char* sse42FindQuote(const char* p, const char* end) {
+    const __m128i quote = _mm_set1_epi8('"');
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        unsigned stop = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, quote)));
+        if (stop) {
+            return p + __builtin_ctz(stop);
+        }
+        p += 16;
+    }
+    return scalarFindQuote(p, end);
+}
+
+GEHU_SSE42 const char* sse42FindNewline(const char* p, const char* end) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        unsigned stop = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline)));
+        if (stop) {
+            return p + __builtin_ctz(stop);
+        }
+        p += 16;
+    }
+    return scalarFindNewline(p, end);
+}
+
+GEHU_SSE42 const char* sse42FindQuoteOrSlash(const char* p, const char* end) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i slash = _mm_set1_epi8('/');
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, slash));
+        unsigned stop = static_cast<unsigned>(_mm_movemask_epi8(hit));
+        if (stop) {
+            return p + __builtin_ctz(stop);
+        }
+        p += 16;
+    }
+    return scalarFindQuoteOrSlash(p, end);
+}
+
+const Kernels sse42Kernels = {
+    Isa::SSE42,
+    sse42SkipWhitespace,
+    sse42SkipIdentifier,
+    sse42SkipDigits,
+    sse42FindQuote,
+    sse42FindNewline,
+    sse42FindQuoteOrSlash,
+};
+
+// ---------------------------------------------------------------------------
+// AVX2: 32 bytes per step with compare + movemask
+// ---------------------------------------------------------------------------
+
+#define GEHU_AVX2 __attribute__((target("avx2,popcnt")))
+
+// Unsigned "v <= limit" per byte
+GEHU_AVX2 inline __m256i avx2AtMost(__m256i v, char limit) {
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(limit)), v);
+}
+
+GEHU_AVX2 inline uint64_t avx2Mask(__m256i v) {
+    return static_cast<uint32_t>(_mm256_movemask_epi8(v));
+}
+
+GEHU_AVX2 const char* avx2SkipWhitespace(const char* p, const char* end) {
+    while (end - p >= 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i blank = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')),
+                            _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\t'))),
+            _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n')));
+        uint64_t stop = ~avx2Mask(blank) & 0xffffffffu;
+        if (stop) {
+            return p + __builtin_ctzll(stop);
+        }
+        p += 32;
+    }
+    return sse42SkipWhitespace(p, end);
+}
+
+GEHU_AVX2 const char* avx2SkipIdentifier(const char* p, const char* end) {
+    while (end - p >= 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        // Folding to lower case maps both letter ranges onto 'a'..'z'
+        __m256i lower = _mm256_or_si256(chunk, _mm256_set1_epi8(0x20));
+        __m256i letter = avx2AtMost(_mm256_sub_epi8(lower, _mm256_set1_epi8('a')), 'z' - 'a');
+        __m256i digit = avx2AtMost(_mm256_sub_epi8(chunk, _mm256_set1_epi8('0')), 9);
+        __m256i underscore = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('_'));
+        uint64_t stop = ~avx2Mask(_mm256_or_si256(_mm256_or_si256(letter, digit), underscore)) & 0xffffffffu;
+        if (stop) {
+            return p + __builtin_ctzll(stop);
+        }
+        p += 32;
+    }
+    return sse42SkipIdentifier(p, end);
+}
+
+GEHU_AVX2 const char* avx2SkipDigits(const char* p, const char* end) {
+    while (end - p >= 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i digit = avx2AtMost(_mm256_sub_epi8(chunk, _mm256_set1_epi8('0')), 9);
+        uint64_t stop = ~avx2Mask(digit) & 0xffffffffu;
+        if (stop) {
+            return p + __builtin_ctzll(stop);
+        }
+        p += 32;
+    }
+    return sse42SkipDigits(p, end);
+}
+
+GEHU_AVX2 const char* avx2FindQuote(const char* p, const char* end) {
+    while (end - p >= 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        uint64_t stop = avx2Mask(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('"')));
+        if (stop) {
+            return p + __builtin_ctzll(stop);
+        }
+        p += 32;
+    }
+    return sse42FindQuote(p, end);
+}
+
+GEHU_AVX2 const char* avx2FindNewline(const char* p, const char* end) {
+    while (end - p >= 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        uint64_t stop = avx2Mask(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n')));
+        if (stop) {
+            return p + __builtin_ctzll(stop);
+        }
+        p += 32;
+    }
+    return sse42FindNewline(p, end);
+}
+
+GEHU_AVX2 const char* avx2FindQuoteOrSlash(const char* p, const char* end) {
+    while (end - p >= 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i hit = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('"')),
+                                      _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('/')));
+        uint64_t stop = avx2Mask(hit);
+        if (stop) {
+            return p + __builtin_ctzll(stop);
+        }
+        p += 32;
+    }
+    return sse42FindQuoteOrSlash(p, end);
+}
+
+const Kernels avx2Kernels = {
+    Isa::AVX2,
+    avx2SkipWhitespace,
+    avx2SkipIdentifier,
+    avx2SkipDigits,
+    avx2FindQuote,
+    avx2FindNewline,
+    avx2FindQuoteOrSlash,
+};
+
+// ---------------------------------------------------------------------------
+// AVX-512BW: 64 bytes per step; compares produce mask registers directly
+// ---------------------------------------------------------------------------
+
+#define GEHU_AVX512 __attribute__((target("avx512f,avx512bw,avx2,popcnt")))
+
+GEHU_AVX512 const char* avx512SkipWhitespace(const char* p, const char* end) {
+    while (end - p >= 64) {
+        __m512i chunk = _mm512_loadu_si512(p);
+        uint64_t blank = _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('\n')) |
+                         _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8(' ')) |
+                         _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('\t'));
+        uint64_t stop = ~blank;
+        if (stop) {
+            return p + __builtin_ctzll(stop);
+        }
+        p += 64;
+    }
+    return avx2SkipWhitespace(p, end);
+}
+
+GEHU_AVX512 const char* avx512SkipIdentifier(const char* p, const char* end) {
+    while (end - p >= 64) {
+        __m512i chunk = _mm512_loadu_si512(p);
+        __m512i lower = _mm512_or_si512(chunk, _mm512_set1_epi8(0x20));
+        uint64_t letter = _mm512_cmple_epu8_mask(_mm512_sub_epi8(lower, _mm512_set1_epi8('a')), _mm512_set1_epi8('z' - 'a'));
+        uint64_t digit = _mm512_cmple_epu8_mask(_mm512_sub_epi8(chunk, _mm512_set1_epi8('0')), _mm512_set1_epi8(9));
+        uint64_t underscore = _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('_'));
+        uint64_t stop = ~(letter | digit | underscore);
+        if (stop) {
+            return p + __builtin_ctzll(stop);
+        }
+        p += 64;
+    }
+    return avx2SkipIdentifier(p, end);
+}
+
+GEHU_AVX512 const char* avx512SkipDigits(const char* p, const char* end) {
+    while (end - p >= 64) {
+        __m512i chunk = _mm512_loadu_si512(p);
+        uint64_t stop = ~static_cast<uint64_t>(
+            _mm512_cmple_epu8_mask(_mm512_sub_epi8(chunk, _mm512_set1_epi8('0')), _mm512_set1_epi8(9)));
+        if (stop) {
+            return p + __builtin_ctzll(stop);
+        }
+        p += 64;
+    }
+    return avx2SkipDigits(p, end);
+}
+
+GEHU_AVX512 const char* avx512FindQuote(const char* p, const char* end) {
+    while (end - p >= 64) {
+        __m512i chunk = _mm512_loadu_si512(p);
+        uint64_t stop = _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('"'));
+        if (stop) {
+            return p + __builtin_ctzll(stop);
+        }
+        p += 64;
+    }
+    return avx2FindQuote(p, end);
+}
+
+GEHU_AVX512 const char* avx512FindNewline(const char* p, const char* end) {
+    while (end - p >= 64) {
+        __m512i chunk = _mm512_loadu_si512(p);
+        uint64_t stop = _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('\n'));
+        if (stop) {
+            return p + __builtin_ctzll(stop);
+        }
+        p += 64;
+    }
+    return avx2FindNewline(p, end);
+}
+
+GEHU_AVX512 const char* avx512FindQuoteOrSlash(const char* p, const char* end) {
+    while (end - p >= 64) {
+        __m512i chunk = _mm512_loadu_si512(p);
+        uint64_t stop = _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('"')) |
+                        _mm512_cmpeq_epi8_mask(chunk, _mm512_set1_epi8('/'));
+        if (stop) {
+            return p + __builtin_ctzll(stop);
+        }
+        p += 64;
+    }
+    return avx2FindQuoteOrSlash(p, end);
+}
+
+const Kernels avx512Kernels = {
+    Isa::AVX512,
+    avx512SkipWhitespace,
+    avx512SkipIdentifier,
+    avx512SkipDigits,
+    avx512FindQuote,
+    avx512FindNewline,
+    avx512FindQuoteOrSlash,
+};
+
+#endif // GEHU_LEXER_SIMD_X86
+
+std::atomic<const Kernels*> selected{nullptr};
+
+} // namespace
+
+bool isSupported(Isa isa) {
+#ifdef GEHU_LEXER_SIMD_X86
+    __builtin_cpu_init();
+    switch (isa) {
+        case Isa::SCALAR: return true;
+        case Isa::SSE42: return __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt");
+        case Isa::AVX2: return isSupported(Isa::SSE42) && __builtin_cpu_supports("avx2");
+        case Isa::AVX512: return isSupported(Isa::AVX2) && __builtin_cpu_supports("avx512bw");
+    }
+    return false;
+#else
+    return isa == Isa::SCALAR;
+#endif
+}
+
+Isa detectIsa() {
+    for (Isa isa : {Isa::AVX512, Isa::AVX2, Isa::SSE42}) {
+        if (isSupported(isa)) {
+            return isa;
+        }
+    }
+    return Isa::SCALAR;
+}
+
+const char* isaName(Isa isa) {
+    switch (isa) {
+        case Isa::SCALAR: return "scalar";
+        case Isa::SSE42: return "sse4.2";
+        case Isa::AVX2: return "avx2";
+        case Isa::AVX512: return "avx512";
+    }
+    return "unknown";
+}
+
+const Kernels& kernelsFor(Isa isa) {
+    switch (isa) {
+#ifdef GEHU_LEXER_SIMD_X86
+        case Isa::SSE42: return sse42Kernels;
+        case Isa::AVX2: return avx2Kernels;
+        case Isa::AVX512: return avx512Kernels;
+#endif
+        default: return scalarKernels;
+    }
+}
+
+const Kernels& active() {
+    const Kernels* kernels = selected.load(std::memory_order_acquire);
+    if (!kernels) {
+        kernels = &kernelsFor(detectIsa());
+        selected.store(kernels, std::memory_order_release);
+    }
+    return *kernels;
+}
+
+void selectIsa(Isa isa) {
+    selected.store(&kernelsFor(isSupported(isa) ? isa : Isa::SCALAR), std::memory_order_release);
+}
+
+} // namespace lexer_simd
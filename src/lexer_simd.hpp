@@ -0,0 +1,50 @@
+//
+//Vectorized scanning kernels for the Lexer
+//Each kernel classifies a run of bytes and returns a pointer to the first
+//byte that ends the run (or end); none of them track lines, which are only
+//worked out for diagnostics (see LineTable)
+//The kernel set is picked once at startup from the CPU's feature bits:
+//AVX-512BW (64 bytes/step), AVX2 (32), SSE4.2 (16) or the scalar loops
+#pragma once
+
+#include <cstddef>
+
+namespace lexer_simd {
+
+enum class Isa {
+    SCALAR,
+    SSE42,
+    AVX2,
+    AVX512
+};
+
+struct Kernels {
+    Isa isa;
+    // Skips ' ', '\t' and '\n'
+    const char* (*skipWhitespace)(const char* p, const char* end);
+    // Skips [A-Za-z0-9_]
+    const char* (*skipIdentifier)(const char* p, const char* end);
+    // Skips [0-9]
+    const char* (*skipDigits)(const char* p, const char* end);
+    // Finds the next '"'
+    const char* (*findQuote)(const char* p, const char* end);
+    // Finds the next '\n'
+    const char* (*findNewline)(const char* p, const char* end);
+    // Finds the next '"' or '/' (string and comment starts, for ParallelLexer)
+    const char* (*findQuoteOrSlash)(const char* p, const char* end);
+};
+
+//Best kernel set for this CPU, or the one forced with selectIsa
+const Kernels& active();
+
+//Kernel set for a specific ISA; only valid when isSupported(isa)
+const Kernels& kernelsFor(Isa isa);
+
+bool isSupported(Isa isa);
+Isa detectIsa();
+const char* isaName(Isa isa);
+
+//Overrides the dispatch for Lexers created afterwards (benchmarks, testing)
+void selectIsa(Isa isa);
+
+} // namespace lexer_simd
@@ -0,0 +1,146 @@
+//
+//Compile-time tables that drive Lexer::nextToken
+//charClasses maps every byte to the scanner that handles it
+//operatorTransitions gives the token for an operator byte, with or without a trailing '='
+//Keywords are found through a perfect hash whose seed is searched at compile time
+#pragma once
+
+#include "lexer.hpp"
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+namespace lexer_tables {
+
+enum class CharClass : uint8_t {
+    INVALID,
+    WHITESPACE,
+    IDENTIFIER_START,
+    DIGIT,
+    QUOTE,
+    SLASH, // '/' starts either a comment or DIVIDE
+    OPERATOR
+};
+
+struct OperatorTransition {
+    TokenType alone; // token for the byte on its own; ERROR when '=' must follow
+    TokenType withEquals; // token when followed by '='; ERROR when there is none
+};
+
+constexpr std::array<CharClass, 256> buildCharClasses() {
+    std::array<CharClass, 256> classes{};
+    for (auto& c : classes) {
+        c = CharClass::INVALID;
+    }
+    for (int c = 'a'; c <= 'z'; ++c) {
+        classes[c] = CharClass::IDENTIFIER_START;
+        classes[c - 'a' + 'A'] = CharClass::IDENTIFIER_START;
+    }
+    for (int c = '0'; c <= '9'; ++c) {
+        classes[c] = CharClass::DIGIT;
+    }
+    classes[' '] = classes['\t'] = classes['\n'] = CharClass::WHITESPACE;
+    classes['"'] = CharClass::QUOTE;
+    classes['/'] = CharClass::SLASH;
+    for (unsigned char c : std::string_view("=!<>;+-*{}()")) {
+        classes[c] = CharClass::OPERATOR;
+    }
+    return classes;
+}
+
+constexpr std::array<OperatorTransition, 256> buildOperatorTransitions() {
+    std::array<OperatorTransition, 256> transitions{};
+    for (auto& t : transitions) {
+        t = OperatorTransition{TokenType::ERROR, TokenType::ERROR};
+    }
+    transitions['='] = {TokenType::EQUALS, TokenType::EQUAL_EQUAL};
+    transitions['!'] = {TokenType::ERROR, TokenType::NOT_EQUAL};
+    transitions['>'] = {TokenType::GREATER_THAN, TokenType::GREATER_EQUAL};
+    transitions['<'] = {TokenType::LESS_THAN, TokenType::LESS_EQUAL};
+    transitions[';'] = {TokenType::SEMICOLON, TokenType::ERROR};
+    transitions['+'] = {TokenType::PLUS, TokenType::ERROR};
+    transitions['-'] = {TokenType::MINUS, TokenType::ERROR};
+    transitions['*'] = {TokenType::MULTIPLY, TokenType::ERROR};
+    transitions['/'] = {TokenType::DIVIDE, TokenType::ERROR};
+    transitions['{'] = {TokenType::LEFT_BRACE, TokenType::ERROR};
+    transitions['}'] = {TokenType::RIGHT_BRACE, TokenType::ERROR};
+    transitions['('] = {TokenType::LEFT_PAREN, TokenType::ERROR};
+    transitions[')'] = {TokenType::RIGHT_PAREN, TokenType::ERROR};
+    return transitions;
+}
+
+inline constexpr std::array<CharClass, 256> charClasses = buildCharClasses();
+inline constexpr std::array<OperatorTransition, 256> operatorTransitions = buildOperatorTransitions();
+
+struct Keyword {
+    std::string_view text;
+    TokenType type;
+};
+
+inline constexpr Keyword keywords[] = {
+    {"let", TokenType::LET},
+    {"show", TokenType::SHOW},
+    {"if", TokenType::IF},
+    {"else", TokenType::ELSE},
+};
+
+constexpr size_t kKeywordSlots = 8; // power of two
+constexpr size_t kMinKeywordLength = 2;
+constexpr size_t kMaxKeywordLength = 4;
+
+constexpr size_t keywordHash(unsigned seed, std::string_view text) {
+    return (static_cast<unsigned char>(text.front()) * seed + static_cast<unsigned char>(text.back()) + text.size()) &
+           (kKeywordSlots - 1);
+}
+
+//Smallest seed for which every keyword lands in its own slot
+constexpr unsigned findKeywordSeed() {
+    for (unsigned seed = 1; seed < 1024; ++seed) {
+        bool used[kKeywordSlots] = {};
+        bool perfect = true;
+        for (const Keyword& keyword : keywords) {
+            size_t slot = keywordHash(seed, keyword.text);
+            perfect = perfect && !used[slot];
+            used[slot] = true;
+        }
+        if (perfect) {
+            return seed;
+        }
+    }
+    return 0;
+}
+
+inline constexpr unsigned keywordSeed = findKeywordSeed();
+static_assert(keywordSeed != 0, "no perfect hash seed for the keyword set");
+
+constexpr std::array<int8_t, kKeywordSlots> buildKeywordSlots() {
+    std::array<int8_t, kKeywordSlots> slots{};
+    for (auto& slot : slots) {
+        slot = -1;
+    }
+    for (size_t i = 0; i < sizeof(keywords) / sizeof(keywords[0]); ++i) {
+        slots[keywordHash(keywordSeed, keywords[i].text)] = static_cast<int8_t>(i);
+    }
+    return slots;
+}
+
+inline constexpr std::array<int8_t, kKeywordSlots> keywordSlots = buildKeywordSlots();
+
+//Keyword type for text, or IDENTIFIER; at most one string compare
+constexpr TokenType classifyWord(std::string_view text) {
+    if (text.size() < kMinKeywordLength || text.size() > kMaxKeywordLength) {
+        return TokenType::IDENTIFIER;
+    }
+    int8_t slot = keywordSlots[keywordHash(keywordSeed, text)];
+    if (slot >= 0 && keywords[slot].text == text) {
+        return keywords[slot].type;
+    }
+    return TokenType::IDENTIFIER;
+}
+
+static_assert(classifyWord("let") == TokenType::LET && classifyWord("show") == TokenType::SHOW &&
+              classifyWord("if") == TokenType::IF && classifyWord("else") == TokenType::ELSE &&
+              classifyWord("lets") == TokenType::IDENTIFIER && classifyWord("i") == TokenType::IDENTIFIER,
+              "keyword table is inconsistent");
+
+} // namespace lexer_tables
@@ -0,0 +1,193 @@
+#include "log.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace logging {
+
+namespace {
+
+constexpr const char* kComponentNames[] = {"main", "lexer", "parser", "sema", "codegen"};
+constexpr const char* kComponentTags[] = {"[main] ", "[Lexer] ", "[Parser] ", "[Sema] ", "[CodeGen] "};
+constexpr const char* kLevelNames[] = {"off", "error", "warning", "info", "debug", "trace"};
+constexpr size_t kFlushThreshold = 64 * 1024;
+
+//Collects lines and writes them out in large chunks. Errors and warnings
+//are written at once so they are not lost if the compiler dies after them
+class Sink {
+public:
+    ~Sink() {
+        setAsync(false);
+        flush();
+        if (file != stderr) {
+            std::fclose(file);
+        }
+    }
+
+    void write(std::string_view line, bool urgent) {
+        std::unique_lock<std::mutex> lock(mutex);
+        pending.append(line.data(), line.size());
+        if (worker.joinable()) {
+            if (urgent || pending.size() >= kFlushThreshold) {
+                ready = true;
+                wake.notify_one();
+            }
+        } else if (urgent || pending.size() >= kFlushThreshold) {
+            writeOut(lock);
+        }
+    }
+
+    void flush() {
+        std::unique_lock<std::mutex> lock(mutex);
+        writeOut(lock);
+        std::lock_guard<std::mutex> io(fileMutex);
+        std::fflush(file);
+    }
+
+    bool open(const std::string& path) {
+        std::FILE* opened = std::fopen(path.c_str(), "w");
+        if (!opened) {
+            return false;
+        }
+        flush();
+        std::lock_guard<std::mutex> lock(mutex);
+        std::lock_guard<std::mutex> io(fileMutex);
+        if (file != stderr) {
+            std::fclose(file);
+        }
+        file = opened;
+        return true;
+    }
+
+    void setAsync(bool async) {
+        if (async == worker.joinable()) {
+            return;
+        }
+        if (async) {
+            stopping = false;
+            worker = std::thread([this] { drain(); });
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+
+private:
+    std::mutex mutex; // guards pending and the flags
+    std::mutex fileMutex; // guards file; taken before mutex is released, so batches keep their order
+    std::condition_variable wake;
+    std::string pending;
+    std::FILE* file = stderr;
+    std::thread worker;
+    bool ready = false; // the writer thread has something to write now
+    bool stopping = false;
+
+    //Writes pending with mutex released, so loggers are not held up by I/O
+    void writeOut(std::unique_lock<std::mutex>& lock) {
+        std::string batch;
+        batch.swap(pending);
+        std::unique_lock<std::mutex> io(fileMutex);
+        lock.unlock();
+        if (!batch.empty()) {
+            std::fwrite(batch.data(), 1, batch.size(), file);
+        }
+        io.unlock();
+        lock.lock();
+    }
+
+    void drain() {
+        std::unique_lock<std::mutex> lock(mutex);
+        bool last = false;
+        while (!last) {
+            wake.wait(lock, [this] { return stopping || ready; });
+            ready = false;
+            last = stopping;
+            writeOut(lock);
+            std::lock_guard<std::mutex> io(fileMutex);
+            std::fflush(file);
+        }
+    }
+};
+
+Sink& sink() {
+    static Sink instance;
+    return instance;
+}
+
+bool parseLevel(std::string_view name, Level& level) {
+    for (size_t i = 0; i < std::size(kLevelNames); ++i) {
+        if (name == kLevelNames[i]) {
+            level = static_cast<Level>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+bool configure(std::string_view spec) {
+    Level updated[std::size(thresholds)];
+    std::copy(std::begin(thresholds), std::end(thresholds), updated);
+    while (!spec.empty()) {
+        size_t comma = spec.find(',');
+        std::string_view entry = spec.substr(0, comma);
+        spec = comma == std::string_view::npos ? std::string_view() : spec.substr(comma + 1);
+
+        Level level = Level::TRACE;
+        size_t colon = entry.find(':');
+        std::string_view name = entry.substr(0, colon);
+        if (colon != std::string_view::npos && !parseLevel(entry.substr(colon + 1), level)) {
+            return false;
+        }
+        if (colon == std::string_view::npos && parseLevel(name, level)) {
+            name = "all";
+        }
+        if (name == "all") {
+            std::fill(std::begin(updated), std::end(updated), level);
+            continue;
+        }
+        size_t component = 0;
+        while (component < std::size(kComponentNames) && name != kComponentNames[component]) {
+            ++component;
+        }
+        if (component == std::size(kComponentNames)) {
+            return false;
+        }
+        updated[component] = level;
+    }
+    std::copy(std::begin(updated), std::end(updated), thresholds);
+    return true;
+}
+
+bool openFile(const std::string& path) {
+    return sink().open(path);
+}
+
+void setAsync(bool async) {
+    sink().setAsync(async);
+}
+
+void flush() {
+    sink().flush();
+}
+
+Record::~Record() {
+    out << '\n';
+    std::string line = kComponentTags[static_cast<size_t>(component)];
+    if (level <= Level::WARNING) {
+        line += level == Level::ERROR ? "error: " : "warning: ";
+    }
+    line += out.str();
+    sink().write(line, level <= Level::WARNING);
+}
+
+} // namespace logging
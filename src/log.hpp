@@ -0,0 +1,87 @@
+//
+//Leveled, per-component logging
+//GEHU_LOG(COMPONENT, LEVEL, a << b << ...) formats and writes one line when
+//LEVEL is enabled for COMPONENT; otherwise the operands are not evaluated
+//Levels above GEHU_LOG_MAX_LEVEL (a build setting) are compiled out, and the
+//rest cost one table load and compare while off. Everything is off until
+//configure() turns it on (the driver's --log)
+//Lines are buffered and written to stderr or a file, either by the thread
+//that logs or, in async mode, by a writer thread
+#pragma once
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+#ifndef GEHU_LOG_MAX_LEVEL
+#define GEHU_LOG_MAX_LEVEL 5 // TRACE
+#endif
+
+namespace logging {
+
+enum class Level : uint8_t {
+    OFF,
+    ERROR,
+    WARNING,
+    INFO,
+    DEBUG,
+    TRACE
+};
+
+enum class Component : uint8_t {
+    MAIN,
+    LEXER,
+    PARSER,
+    SEMA,
+    CODEGEN,
+    COUNT
+};
+
+//Most verbose level enabled per component; written only by configure()
+inline Level thresholds[static_cast<size_t>(Component::COUNT)] = {};
+
+inline bool enabled(Component component, Level level) {
+    return level <= thresholds[static_cast<size_t>(component)];
+}
+
+//Applies a comma separated list of component[:level] entries, e.g.
+//"lexer,codegen:debug". A component without a level logs everything; "all"
+//names every component, and a bare level applies to all of them
+//Returns false, changing nothing, when the list does not parse
+bool configure(std::string_view spec);
+
+//Writes to path instead of stderr; returns false when it cannot be opened
+bool openFile(const std::string& path);
+//Hands lines to a writer thread instead of writing them on the logging one
+void setAsync(bool async);
+//Writes out everything logged so far
+void flush();
+
+//One line being formatted; written when it goes away
+class Record {
+public:
+    Record(Component component, Level level) : component(component), level(level) {}
+    Record(const Record&) = delete;
+    Record& operator=(const Record&) = delete;
+    ~Record();
+
+    std::ostream& stream() { return out; }
+
+private:
+    Component component;
+    Level level;
+    std::ostringstream out;
+};
+
+} // namespace logging
+
+#define GEHU_LOG(component, level, message)                                                        \
+    do {                                                                                           \
+        if constexpr (static_cast<int>(logging::Level::level) <= GEHU_LOG_MAX_LEVEL) {             \
+            if (__builtin_expect(logging::enabled(logging::Component::component, logging::Level::level), 0)) { \
+                logging::Record gehuLogRecord(logging::Component::component, logging::Level::level); \
+                gehuLogRecord.stream() << message;                                                 \
+            }                                                                                      \
+        }                                                                                          \
+    } while (0)
@@ -1,87 +1,429 @@
+#include "ast_cache.hpp"
 #include "lexer.hpp"
+#include "parallel_lexer.hpp"
+#include "parallel_parser.hpp"
 #include "parser.hpp"
 #include "semantic_analyzer.hpp"
 #include "codegen.hpp"
 #include "errors.hpp"
-#include <fstream>
-#include <sstream> //String stream operations
+#include "heap_profile.hpp"
+#include "log.hpp"
+#include "perf_counters.hpp"
+#include "source_manager.hpp"
+#include "stats.hpp"
+#include <llvm/Support/TimeProfiler.h> //for --trace
+#include <llvm/Support/raw_ostream.h>
+#include <cstdint>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
 
-std::string readFile(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        throw std::runtime_error("Could not open file: " + filename);
+//Command line options
+struct Options {
+    std::string sourceFile; // "-" reads stdin
+    bool streamTokens = false; // parser pulls tokens from the lexer on demand
+    bool flatAst = false; // build the index-based FlatAst instead of the node tree
+    size_t maxDepth = Parser::kDefaultMaxDepth; // deepest nesting the parser accepts
+    size_t maxErrors = ErrorCollector::kDefaultLimit; // errors reported per phase, 0 for all
+    size_t threads = 1; // lexer and parser threads, 0 for one per hardware thread
+    CodeGenerator::OptLevel optLevel = CodeGenerator::OptLevel::O0;
+    std::string astCacheDir; // where parsed ASTs are cached; empty disables the cache
+    bool verifyAstCache = false; // reparse on a cache hit and compare
+    std::string logFile; // log to this file instead of stderr
+    bool stats = false; // print phase times and counters at exit
+    bool statsJson = false; // ... as JSON
+    bool heapProfile = false; // ... with each phase's heap allocations
+    bool perfCounters = false; // ... and hardware events
+    std::string traceFile; // write a Chrome trace-event timeline here
+    size_t traceGranularity = 0; // leave out spans shorter than this many microseconds
+};
+
+static void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] <source_file | ->" << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "  --stream    lex on demand while parsing instead of building a token array" << std::endl;
+    std::cerr << "  --flat-ast  parse into the flat index-based AST and run the later phases on it" << std::endl;
+    std::cerr << "  --max-depth=N  reject blocks and parentheses nested deeper than N (default " << Parser::kDefaultMaxDepth << ")" << std::endl;
+    std::cerr << "  --max-errors=N  stop after N errors, 0 for no limit (default " << ErrorCollector::kDefaultLimit << ")" << std::endl;
+    std::cerr << "  --threads=N  lex and parse large files on N threads, 0 for all hardware threads (default 1)" << std::endl;
+    std::cerr << "  -O0 -O1 -O2 -O3 -Os  optimization level of the IR passes and machine code (default -O0)" << std::endl;
+    std::cerr << "  --ast-cache=DIR  reuse the flat AST of an unchanged source from DIR (implies --flat-ast)" << std::endl;
+    std::cerr << "  --verify-ast-cache  on a cache hit, also parse the source and check the two ASTs match" << std::endl;
+    std::cerr << "  --log=LIST  log component[:level] entries, e.g. lexer,codegen:debug; components are" << std::endl;
+    std::cerr << "              main, lexer, parser, sema, codegen or all; levels are error, warning, info," << std::endl;
+    std::cerr << "              debug and trace (the default for a named component)" << std::endl;
+    std::cerr << "  --log-file=PATH  write the log to PATH instead of stderr" << std::endl;
+    std::cerr << "  --log-async  write the log from a background thread" << std::endl;
+    std::cerr << "  --stats[=json]  print the time spent in each phase and what it produced to stderr" << std::endl;
+    std::cerr << "  --time-report  same as --stats" << std::endl;
+    std::cerr << "  --heap-profile  add each phase's heap allocations to --stats (implies --stats)" << std::endl;
+    std::cerr << "  --perf-counters  add each phase's cycles, instructions, branch and cache misses to --stats" << std::endl;
+    std::cerr << "                   (implies --stats)" << std::endl;
+    std::cerr << "  --trace=FILE  write a timeline of the phases, top-level statements and LLVM passes" << std::endl;
+    std::cerr << "                as Chrome trace events, for chrome://tracing or Perfetto" << std::endl;
+    std::cerr << "  --trace-granularity=US  leave spans shorter than US microseconds out of the trace (default 0)" << std::endl;
+}
+
+//Parses the N of --name=N into value; N above max is invalid too
+static bool parseCount(const std::string& arg, size_t prefixLength, size_t& value, size_t max = SIZE_MAX) {
+    std::string digits = arg.substr(prefixLength);
+    if (digits.empty() || digits.size() > 18 || digits.find_first_not_of("0123456789") != std::string::npos ||
+        std::stoull(digits) > max) {
+        std::cerr << "Invalid value: " << arg << std::endl;
+        return false;
     }
-    
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    return buffer.str();
+    value = std::stoull(digits);
+    return true;
+}
+
+static bool parseArguments(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-O0") {
+            options.optLevel = CodeGenerator::OptLevel::O0;
+        } else if (arg == "-O1") {
+            options.optLevel = CodeGenerator::OptLevel::O1;
+        } else if (arg == "-O2") {
+            options.optLevel = CodeGenerator::OptLevel::O2;
+        } else if (arg == "-O3") {
+            options.optLevel = CodeGenerator::OptLevel::O3;
+        } else if (arg == "-Os") {
+            options.optLevel = CodeGenerator::OptLevel::OS;
+        } else if (arg == "--stream") {
+            options.streamTokens = true;
+        } else if (arg == "--flat-ast") {
+            options.flatAst = true;
+        } else if (arg.rfind("--max-depth=", 0) == 0) {
+            if (!parseCount(arg, 12, options.maxDepth)) {
+                return false;
+            }
+        } else if (arg.rfind("--max-errors=", 0) == 0) {
+            if (!parseCount(arg, 13, options.maxErrors)) {
+                return false;
+            }
+        } else if (arg.rfind("--threads=", 0) == 0) {
+            if (!parseCount(arg, 10, options.threads, 1024)) {
+                return false;
+            }
+        } else if (arg.rfind("--ast-cache=", 0) == 0 && arg.size() > 12) {
+            options.astCacheDir = arg.substr(12);
+            options.flatAst = true;
+        } else if (arg == "--verify-ast-cache") {
+            options.verifyAstCache = true;
+        } else if (arg.rfind("--log=", 0) == 0) {
+            if (!logging::configure(std::string_view(arg).substr(6))) {
+                std::cerr << "Invalid value: " << arg << std::endl;
+                return false;
+            }
+        } else if (arg.rfind("--log-file=", 0) == 0 && arg.size() > 11) {
+            options.logFile = arg.substr(11);
+        } else if (arg == "--log-async") {
+            logging::setAsync(true);
+        } else if (arg == "--stats" || arg == "--time-report") {
+            options.stats = true;
+        } else if (arg.rfind("--trace=", 0) == 0 && arg.size() > 8) {
+            options.traceFile = arg.substr(8);
+        } else if (arg.rfind("--trace-granularity=", 0) == 0) {
+            if (!parseCount(arg, 20, options.traceGranularity, 1000000000)) {
+                return false;
+            }
+        } else if (arg == "--heap-profile") {
+            options.stats = true;
+            options.heapProfile = true;
+        } else if (arg == "--perf-counters") {
+            options.stats = true;
+            options.perfCounters = true;
+        } else if (arg == "--stats=json") {
+            options.stats = true;
+            options.statsJson = true;
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return false;
+        } else if (options.sourceFile.empty()) {
+            options.sourceFile = arg;
+        } else {
+            return false;
+        }
+    }
+    return !options.sourceFile.empty();
+}
+
+//Prints an error, prefixed with file:line:column when it has a position
+static void printError(const CompilerError& error, const SourceBuffer* input) {
+    // Whatever was logged before the error comes out first
+    logging::flush();
+    if (input && error.hasLocation()) {
+        // Offsets become line:column only here, when there is something to report
+        LineColumn at = input->location(error.getOffset());
+        std::cerr << input->getName() << ":" << at.line << ":" << at.column << ": ";
+    }
+    std::cerr << "Error: " << error.what() << std::endl;
+}
+
+//Writes the time trace profiler's events to path and stops the profiler
+static bool writeTrace(const std::string& path) {
+    std::error_code error;
+    llvm::raw_fd_ostream out(path, error);
+    if (!error) {
+        llvm::timeTraceProfilerWrite(out);
+    }
+    llvm::timeTraceProfilerCleanup();
+    if (error || out.has_error()) {
+        std::cerr << "Error: could not write trace: " << path << std::endl;
+        out.clear_error();
+        return false;
+    }
+    return true;
 }
 
 //Main function
 //argc: Argument count
 //argv: Argument vector
 //argv[0]: Program name
-//argv[1]: Source file name
-//argv[2]: Output file name
-//argv[3]: Error file name
-//argv[4]: Log file name
+//argv[1..]: Options followed by the source file name ("-" reads stdin)
 
 int main(int argc, char** argv) {
-    std::cout << "[main] Program started" << std::endl;
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <source_file>" << std::endl;
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        printUsage(argv[0]);
         return 1;
     }
+    if (!options.logFile.empty() && !logging::openFile(options.logFile)) {
+        std::cerr << "Error: could not open log file: " << options.logFile << std::endl;
+        return 1;
+    }
+    if (!options.traceFile.empty()) {
+        llvm::timeTraceProfilerInitialize(static_cast<unsigned>(options.traceGranularity), "gehu");
+    }
+    GEHU_LOG(MAIN, INFO, "Program started");
     
+    SourceManager sources;
+    const SourceBuffer* input = nullptr;
+    Stats stats;
+    if (options.heapProfile) {
+        heap_profile::enable();
+        stats.heapProfiled = true;
+    }
+    PerfCounters perf;
+    if (options.perfCounters) {
+        // When nothing opens, the report says why
+        perf.open();
+        stats.perf = &perf;
+    }
+    int status = 0;
     try {
-        std::cout << "[main] Reading source file..." << std::endl;
-        std::string source = readFile(argv[1]);
-        std::cout << "[main] Source file read successfully." << std::endl;
+        GEHU_LOG(MAIN, INFO, "Reading source file...");
+        {
+            PhaseTimer timer(stats, Stats::Phase::READ);
+            input = &sources.load(options.sourceFile);
+        }
+        const SourceBuffer& source = *input;
+        stats.counters.sourceBytes = source.text().size();
+        GEHU_LOG(MAIN, INFO, "Source file read successfully.");
         
 
-        std::cout << "[main] Starting lexical analysis..." << std::endl;
-        Lexer lexer(source);
-        std::vector<Token> tokens;
-        Token token;
-        do {
-            token = lexer.nextToken();
-            tokens.push_back(token);
-        } while (token.type != TokenType::EOF_TOKEN);
-        std::cout << "[main] Lexical analysis complete. Token count: " << tokens.size() << std::endl;
+        StringInterner symbols;
+        std::unique_ptr<Program> program;
+        FlatAst flat;
+        // Lexes and parses the source into program or flat, interning into names
+        auto parseSource = [&](StringInterner& names) {
+            Lexer lexer(source.text(), names);
+            std::vector<Token> tokens;
+            auto runParser = [&](Parser& parser) {
+                parser.setMaxDepth(options.maxDepth);
+                parser.setErrorLimit(options.maxErrors);
+                if (options.flatAst) {
+                    flat = parser.parseFlat();
+                } else {
+                    program = parser.parse();
+                }
+            };
+            if (options.streamTokens) {
+                // Lexing is interleaved with parsing; no token array is built
+                GEHU_LOG(MAIN, INFO, "Starting streaming lexing and parsing...");
+                PhaseTimer timer(stats, Stats::Phase::PARSE);
+                Parser parser(lexer);
+                // Counted also when parsing fails, for the report printed then
+                auto countLexed = [&] {
+                    stats.counters.tokens = lexer.tokenCount();
+                    stats.counters.symbols = names.size();
+                };
+                try {
+                    runParser(parser);
+                } catch (...) {
+                    countLexed();
+                    throw;
+                }
+                countLexed();
+                GEHU_LOG(MAIN, INFO, "Parsing complete.");
+                return;
+            }
+            GEHU_LOG(MAIN, INFO, "Starting lexical analysis...");
+            std::optional<PhaseTimer> timer(std::in_place, stats, Stats::Phase::LEX);
+            if (options.threads == 1) {
+                Token token;
+                do {
+                    token = lexer.nextToken();
+                    tokens.push_back(token);
+                } while (token.type != TokenType::EOF_TOKEN);
+            } else {
+                ParallelLexer parallel(source.text(), names);
+                parallel.setThreadCount(static_cast<unsigned>(options.threads));
+                tokens = parallel.tokenize();
+            }
+            timer.reset();
+            // Lexing interns every name, so this holds even if parsing fails
+            stats.counters.tokens = tokens.size();
+            stats.counters.symbols = names.size();
+            GEHU_LOG(MAIN, INFO, "Lexical analysis complete. Token count: " << tokens.size());
+            
+
+
+            GEHU_LOG(MAIN, INFO, "Starting parsing...");
+            timer.emplace(stats, Stats::Phase::PARSE);
+            if (options.threads == 1 || options.flatAst) {
+                Parser parser(tokens);
+                runParser(parser);
+            } else {
+                ParallelParser parser(tokens);
+                parser.setThreadCount(static_cast<unsigned>(options.threads));
+                parser.setMaxDepth(options.maxDepth);
+                parser.setErrorLimit(options.maxErrors);
+                program = parser.parse();
+            }
+            GEHU_LOG(MAIN, INFO, "Parsing complete.");
+        };
+
+        if (options.astCacheDir.empty()) {
+            parseSource(symbols);
+        } else {
+            AstCache cache(options.astCacheDir);
+            bool hit;
+            {
+                PhaseTimer timer(stats, Stats::Phase::PARSE);
+                hit = cache.load(source.text(), symbols, flat);
+            }
+            if (hit) {
+                GEHU_LOG(MAIN, INFO, "AST cache hit: " << cache.path(source.text()));
+                if (options.verifyAstCache) {
+                    FlatAst cached = std::move(flat);
+                    StringInterner fresh;
+                    parseSource(fresh);
+                    bool same = flat == cached && fresh.size() == symbols.size();
+                    for (SymbolId id = 0; same && id < fresh.size(); ++id) {
+                        same = fresh.name(id) == symbols.name(id);
+                    }
+                    if (!same) {
+                        throw std::runtime_error("Cached AST differs from a fresh parse: " + cache.path(source.text()));
+                    }
+                    GEHU_LOG(MAIN, INFO, "Cached AST matches a fresh parse.");
+                }
+            } else {
+                parseSource(symbols);
+                try {
+                    cache.store(source.text(), symbols, flat);
+                } catch (const std::runtime_error& e) {
+                    // A cache that cannot be written only costs the next run its hit
+                    std::cerr << "Warning: " << e.what() << std::endl;
+                }
+            }
+        }
         
 
 
-        std::cout << "[main] Starting parsing..." << std::endl;
-        Parser parser(tokens);
-        auto program = parser.parse();
-        std::cout << "[main] Parsing complete." << std::endl;
+        stats.counters.symbols = symbols.size();
+        if (options.stats) {
+            if (options.flatAst) {
+                stats.countNodes(flat);
+            } else {
+                stats.countNodes(*program);
+            }
+        }
         
 
 
-        std::cout << "[main] Starting semantic analysis..." << std::endl;
-        SemanticAnalyzer analyzer;
-        analyzer.analyze(program.get());
-        std::cout << "[main] Semantic analysis complete." << std::endl;
+        GEHU_LOG(MAIN, INFO, "Starting semantic analysis...");
+        {
+            PhaseTimer timer(stats, Stats::Phase::SEMA);
+            SemanticAnalyzer analyzer(symbols);
+            analyzer.setErrorLimit(options.maxErrors);
+            if (options.flatAst) {
+                analyzer.analyze(flat);
+            } else {
+                analyzer.analyze(program.get());
+            }
+        }
+        GEHU_LOG(MAIN, INFO, "Semantic analysis complete.");
         
 
 
-        std::cout << "[main] Starting code generation..." << std::endl;
-        CodeGenerator codegen;
-        codegen.generate(program.get());
-        std::cout << "[main] Code generation complete. Running program..." << std::endl;
-        codegen.run();
-        std::cout << "[main] Program execution finished." << std::endl;
+        GEHU_LOG(MAIN, INFO, "Starting code generation...");
+        CodeGenerator codegen(symbols);
+        codegen.setOptLevel(options.optLevel);
+        {
+            PhaseTimer timer(stats, Stats::Phase::CODEGEN);
+            if (options.flatAst) {
+                codegen.generate(flat);
+            } else {
+                codegen.generate(program.get());
+            }
+        }
+        {
+            PhaseTimer timer(stats, Stats::Phase::VERIFY);
+            codegen.verify();
+        }
+        {
+            PhaseTimer timer(stats, Stats::Phase::OPTIMIZE);
+            codegen.optimize();
+        }
+        // The IR the JIT compiles, after the -O passes
+        if (options.stats) {
+            stats.countIr(*codegen.getModule());
+        }
+        GEHU_LOG(MAIN, INFO, "Code generation complete. Running program...");
+        {
+            PhaseTimer timer(stats, Stats::Phase::JIT_SETUP);
+            codegen.prepare();
+        }
+        stats.counters.machineCodeBytes = codegen.machineCodeBytes();
+        {
+            PhaseTimer timer(stats, Stats::Phase::EXECUTE);
+            codegen.execute();
+        }
+        GEHU_LOG(MAIN, INFO, "Program execution finished.");
         
 
         
+    } catch (const CompilerErrorList& e) {
+        for (const CompilerError& error : e.getErrors()) {
+            printError(error, input);
+        }
+        if (e.isTruncated()) {
+            std::cerr << "Error: too many errors, stopping after " << e.getErrors().size() << std::endl;
+        }
+        status = 1;
     } catch (const CompilerError& e) {
-        std::cerr << "Error: " << e.what() << std::endl;
-        return 1;
+        printError(e, input);
+        status = 1;
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
-        return 1;
+        status = 1;
     }
-    
-    return 0;
+
+    // Reported after errors too, for the phases that ran
+    if (options.stats) {
+        std::cout.flush();
+        logging::flush();
+        if (options.statsJson) {
+            stats.printJson(std::cerr);
+        } else {
+            stats.print(std::cerr);
+        }
+    }
+    if (!options.traceFile.empty() && !writeTrace(options.traceFile)) {
+        status = 1;
+    }
+    return status;
 } 
\ No newline at end of file
@@ -0,0 +1,35 @@
+//
+//Fork-join helper shared by ParallelLexer and ParallelParser
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+//Runs task(i) for every i below count, each on its own thread; the calling
+//thread takes i = 0. task must not throw
+template <typename Task>
+void runConcurrently(size_t count, const Task& task) {
+    std::vector<std::thread> threads;
+    threads.reserve(count - 1);
+    for (size_t i = 1; i < count; ++i) {
+        threads.emplace_back(task, i);
+    }
+    task(0);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+//Threads to use for a requested count; 0 means one per hardware thread
+inline unsigned resolveThreadCount(unsigned requested) {
+    return requested != 0 ? requested : std::max(1u, std::thread::hardware_concurrency());
+}
+
+//Chunks to cut size units of input into: one per thread, but none smaller
+//than minChunk, since a smaller chunk does not pay for starting its thread.
+//1 means the caller should run serially
+inline size_t chunksFor(unsigned requestedThreads, size_t size, size_t minChunk) {
+    return std::min<size_t>(resolveThreadCount(requestedThreads), size / std::max<size_t>(minChunk, 1));
+}
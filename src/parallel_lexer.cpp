@@ -0,0 +1,163 @@
+#include "parallel_lexer.hpp"
+#include "lexer_simd.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <array>
+#include <exception>
+
+namespace {
+
+//Lexer state at a line start: between tokens, or inside a string literal
+enum ScanState { CODE = 0, STRING = 1 };
+
+//State after scanning [p, end) from state; a comment always ends before a
+//chunk end, because chunks end just after a newline
+ScanState scanChunk(const lexer_simd::Kernels& kernels, const char* p, const char* end, const char* sourceEnd,
+                    ScanState state) {
+    while (p < end) {
+        if (state == STRING) {
+            p = kernels.findQuote(p, end);
+            if (p == end) {
+                break;
+            }
+            ++p;
+            state = CODE;
+            continue;
+        }
+        p = kernels.findQuoteOrSlash(p, end);
+        if (p == end) {
+            break;
+        }
+        if (*p == '"') {
+            ++p;
+            state = STRING;
+        } else if (p + 1 < sourceEnd && p[1] == '/') {
+            p = kernels.findNewline(p + 2, end);
+        } else {
+            ++p; // division operator
+        }
+    }
+    return state;
+}
+
+//One chunk's tokens, with symbols from its private interner
+struct Chunk {
+    std::vector<Token> tokens;
+    StringInterner symbols;
+    std::exception_ptr error;
+};
+
+} // namespace
+
+ParallelLexer::ParallelLexer(std::string_view source, StringInterner& symbols)
+    : source(source), symbols(symbols), threadCount(0), minChunkSize(kDefaultMinChunkSize) {}
+
+//Chunk boundaries: roughly equal slices, each moved to just after a newline
+std::vector<size_t> ParallelLexer::chunkStarts(size_t chunkCount) const {
+    const lexer_simd::Kernels& kernels = lexer_simd::active();
+    const char* begin = source.data();
+    const char* end = begin + source.size();
+    std::vector<size_t> cuts(chunkCount + 1, source.size());
+    cuts[0] = 0;
+    for (size_t i = 1; i < chunkCount; ++i) {
+        size_t nominal = std::max(source.size() / chunkCount * i, cuts[i - 1]);
+        const char* newline = kernels.findNewline(begin + nominal, end);
+        cuts[i] = newline == end ? source.size() : static_cast<size_t>(newline + 1 - begin);
+    }
+    return cuts;
+}
+
+std::vector<Token> ParallelLexer::tokenize() {
+    // The serial Lexer also rejects oversized sources
+    Lexer serial(source, symbols);
+    size_t chunkCount = chunksFor(threadCount, source.size(), minChunkSize);
+    if (chunkCount <= 1) {
+        std::vector<Token> tokens;
+        Token token;
+        do {
+            token = serial.nextToken();
+            tokens.push_back(token);
+        } while (token.type != TokenType::EOF_TOKEN);
+        return tokens;
+    }
+
+    const lexer_simd::Kernels& kernels = lexer_simd::active();
+    const char* begin = source.data();
+    const char* end = begin + source.size();
+    std::vector<size_t> cuts = chunkStarts(chunkCount);
+
+    // Prefix scan: each chunk's exit state for both entry states in parallel,
+    // then one pass in order picks the real entry state of every chunk
+    std::vector<std::array<ScanState, 2>> exits(chunkCount);
+    runConcurrently(chunkCount, [&](size_t i) {
+        for (ScanState entry : {CODE, STRING}) {
+            exits[i][entry] = scanChunk(kernels, begin + cuts[i], begin + cuts[i + 1], end, entry);
+        }
+    });
+    // A chunk cut inside a string starts after its closing quote; the string
+    // belongs to the chunk where it opened
+    std::vector<size_t> starts(chunkCount + 1, source.size());
+    ScanState state = CODE;
+    for (size_t i = 0; i < chunkCount; ++i) {
+        if (state == CODE) {
+            starts[i] = cuts[i];
+        } else {
+            const char* quote = kernels.findQuote(begin + cuts[i], end);
+            starts[i] = quote == end ? source.size() : static_cast<size_t>(quote + 1 - begin);
+        }
+        state = exits[i][state];
+    }
+
+    // Each chunk stops at the first token of the next one
+    std::vector<Chunk> chunks(chunkCount);
+    runConcurrently(chunkCount, [&](size_t i) {
+        Chunk& chunk = chunks[i];
+        try {
+            Lexer lexer(source, chunk.symbols);
+            lexer.setPosition(starts[i]);
+            while (true) {
+                Token token = lexer.nextToken();
+                if (token.type == TokenType::EOF_TOKEN || token.offset >= starts[i + 1]) {
+                    break;
+                }
+                chunk.tokens.push_back(token);
+            }
+        } catch (...) {
+            chunk.error = std::current_exception();
+        }
+    });
+    // Chunks are in source order, so the first failed one holds the first error
+    for (const Chunk& chunk : chunks) {
+        if (chunk.error) {
+            std::rethrow_exception(chunk.error);
+        }
+    }
+
+    // Interning each chunk's names in order of first use, chunk after chunk,
+    // hands out ids in the serial order. A chunk's interner may also hold the
+    // name of the next chunk's first token, which comes next in that order anyway
+    std::vector<std::vector<SymbolId>> remaps(chunkCount);
+    std::vector<size_t> firstToken(chunkCount + 1, 0);
+    for (size_t i = 0; i < chunkCount; ++i) {
+        std::vector<SymbolId>& remap = remaps[i];
+        remap.resize(chunks[i].symbols.size());
+        for (SymbolId id = 0; id < remap.size(); ++id) {
+            remap[id] = symbols.intern(chunks[i].symbols.name(id));
+        }
+        firstToken[i + 1] = firstToken[i] + chunks[i].tokens.size();
+    }
+
+    std::vector<Token> tokens(firstToken[chunkCount] + 1);
+    runConcurrently(chunkCount, [&](size_t i) {
+        Token* out = tokens.data() + firstToken[i];
+        for (const Token& token : chunks[i].tokens) {
+            *out = token;
+            if (token.symbol != kInvalidSymbol) {
+                out->symbol = remaps[i][token.symbol];
+            }
+            ++out;
+        }
+    });
+    tokens.back() = Token(TokenType::EOF_TOKEN, "", static_cast<SourceOffset>(source.size()));
+    return tokens;
+}
@@ -0,0 +1,41 @@
+//
+//ParallelLexer: tokenizes one large buffer on several threads
+//The buffer is cut at line starts into one chunk per thread. A line start is
+//never inside a token or a comment, but it can be inside a string literal,
+//so a quick SIMD prefix scan first works out which cuts fall in a string;
+//those chunks begin after the string's closing quote instead
+//Each chunk is lexed by its own Lexer and interner; the chunks' symbols are
+//then interned in chunk order, so ids, offsets and errors come out exactly
+//as the serial Lexer would produce them
+#pragma once
+
+#include "interner.hpp"
+#include "lexer.hpp"
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+class ParallelLexer {
+public:
+    // Fewest bytes per thread; see chunksFor in parallel.hpp
+    static constexpr size_t kDefaultMinChunkSize = 256 * 1024;
+
+    // source must outlive the tokens, as for Lexer
+    ParallelLexer(std::string_view source, StringInterner& symbols);
+
+    // As for resolveThreadCount in parallel.hpp
+    void setThreadCount(unsigned count) { threadCount = count; }
+    void setMinChunkSize(size_t bytes) { minChunkSize = bytes; }
+
+    // Every token up to and including EOF_TOKEN; throws the LexerError the
+    // serial Lexer would have thrown first
+    std::vector<Token> tokenize();
+
+private:
+    std::string_view source;
+    StringInterner& symbols;
+    unsigned threadCount;
+    size_t minChunkSize;
+
+    std::vector<size_t> chunkStarts(size_t chunkCount) const;
+};
@@ -0,0 +1,120 @@
+#include "parallel_parser.hpp"
+#include "parallel.hpp"
+#include <exception>
+
+namespace {
+
+//One range's result
+struct Chunk {
+    std::unique_ptr<Program> program;
+    std::vector<CompilerError> errors;
+    bool truncated = false;
+    std::exception_ptr failure; // anything but syntax errors
+};
+
+} // namespace
+
+ParallelParser::ParallelParser(const std::vector<Token>& tokens)
+    : tokens(tokens),
+      threadCount(0),
+      minChunkTokens(kDefaultMinChunkTokens),
+      maxDepth(Parser::kDefaultMaxDepth),
+      errorLimit(ErrorCollector::kDefaultLimit) {}
+
+//Range boundaries: the first statement boundary at or after each nominal
+//cut. Braces are counted as the Parser's recovery counts them; a stray '}'
+//at top level is a statement of its own
+std::vector<size_t> ParallelParser::chunkStarts(size_t chunkCount) const {
+    size_t end = tokens.size() - 1; // EOF_TOKEN
+    std::vector<size_t> cuts(1, 0);
+    size_t next = end / chunkCount;
+    size_t depth = 0;
+    for (size_t i = 0; i < end && cuts.size() < chunkCount; ++i) {
+        bool boundary = false;
+        switch (tokens[i].type) {
+            case TokenType::LEFT_BRACE:
+                ++depth;
+                break;
+            case TokenType::RIGHT_BRACE:
+                if (depth > 0) {
+                    --depth;
+                }
+                boundary = depth == 0 && tokens[i + 1].type != TokenType::ELSE;
+                break;
+            case TokenType::SEMICOLON:
+                boundary = depth == 0;
+                break;
+            default:
+                break;
+        }
+        if (boundary && i + 1 >= next && i + 1 < end) {
+            cuts.push_back(i + 1);
+            next = end / chunkCount * cuts.size();
+        }
+    }
+    cuts.push_back(end);
+    return cuts;
+}
+
+std::unique_ptr<Program> ParallelParser::parse() {
+    size_t chunkCount = chunksFor(threadCount, tokens.size(), minChunkTokens);
+    std::vector<size_t> cuts = chunkCount > 1 ? chunkStarts(chunkCount) : std::vector<size_t>();
+    if (cuts.size() <= 2) {
+        Parser parser(tokens);
+        parser.setMaxDepth(maxDepth);
+        parser.setErrorLimit(errorLimit);
+        return parser.parse();
+    }
+    chunkCount = cuts.size() - 1;
+
+    // Every range but the last ends where the next begins; the token there
+    // stands in as its EOF so errors at the end point at the same offset
+    std::vector<Chunk> chunks(chunkCount);
+    runConcurrently(chunkCount, [&](size_t i) {
+        Chunk& chunk = chunks[i];
+        try {
+            Token eof(TokenType::EOF_TOKEN, "", tokens[cuts[i + 1]].offset);
+            Parser parser(tokens.data() + cuts[i], cuts[i + 1] - cuts[i], eof);
+            parser.setMaxDepth(maxDepth);
+            parser.setErrorLimit(errorLimit);
+            chunk.program = parser.parse();
+        } catch (const CompilerErrorList& list) {
+            chunk.errors = list.getErrors();
+            chunk.truncated = list.isTruncated();
+        } catch (...) {
+            chunk.failure = std::current_exception();
+        }
+    });
+
+    // The serial Parser would have stopped at the limit-th error, wherever
+    // that falls, and reports the first errors in source order
+    std::vector<CompilerError> errors;
+    for (Chunk& chunk : chunks) {
+        if (chunk.failure) {
+            std::rethrow_exception(chunk.failure);
+        }
+        errors.insert(errors.end(), chunk.errors.begin(), chunk.errors.end());
+        if (chunk.truncated || (errorLimit != 0 && errors.size() >= errorLimit)) {
+            if (errorLimit != 0 && errors.size() > errorLimit) {
+                errors.erase(errors.begin() + errorLimit, errors.end());
+            }
+            throw CompilerErrorList(std::move(errors), true);
+        }
+    }
+    if (!errors.empty()) {
+        throw CompilerErrorList(std::move(errors), false);
+    }
+
+    size_t total = 0;
+    for (const Chunk& chunk : chunks) {
+        total += chunk.program->statements.size();
+    }
+    auto program = std::move(chunks[0].program);
+    program->statements.reserve(total);
+    for (size_t i = 1; i < chunkCount; ++i) {
+        Program& part = *chunks[i].program;
+        program->statements.insert(program->statements.end(), part.statements.begin(), part.statements.end());
+        program->arena.adopt(std::move(part.arena));
+    }
+    return program;
+}
@@ -0,0 +1,48 @@
+//
+//ParallelParser: parses one token array on several threads
+//A top-level statement ends at a ';' outside any braces, or at the '}' that
+//closes its outermost block when no else follows. A pre-scan of the tokens
+//finds such boundaries and cuts the array there into one range per thread,
+//each holding roughly the same number of tokens
+//At a boundary the serial Parser is always back at the start of a top-level
+//statement, also while recovering from an error, so every range is parsed as
+//a program of its own. The ranges' statements and arenas are then moved into
+//one Program in source order, and their errors concatenated, so the result
+//and the reported errors match the serial Parser
+#pragma once
+
+#include "ast.hpp"
+#include "errors.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+class ParallelParser {
+public:
+    // Fewest tokens per thread; see chunksFor in parallel.hpp
+    static constexpr size_t kDefaultMinChunkTokens = 64 * 1024;
+
+    // tokens must end with EOF_TOKEN and outlive the parser, as for Parser
+    explicit ParallelParser(const std::vector<Token>& tokens);
+    ParallelParser(std::vector<Token>&&) = delete;
+
+    // As for resolveThreadCount in parallel.hpp
+    void setThreadCount(unsigned count) { threadCount = count; }
+    void setMinChunkTokens(size_t count) { minChunkTokens = count; }
+    void setMaxDepth(size_t depth) { maxDepth = depth; }
+    void setErrorLimit(size_t limit) { errorLimit = limit; }
+
+    // Throws the CompilerErrorList the serial Parser would have thrown
+    std::unique_ptr<Program> parse();
+
+private:
+    const std::vector<Token>& tokens;
+    unsigned threadCount;
+    size_t minChunkTokens;
+    size_t maxDepth;
+    size_t errorLimit;
+
+    std::vector<size_t> chunkStarts(size_t chunkCount) const;
+};
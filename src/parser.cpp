@@ -8,171 +8,393 @@
 //It also handles errors
 #include "parser.hpp"
 #include "errors.hpp"
+#include "log.hpp"
+#include "parser_tables.hpp" //for the binary operator table
+#include <charconv> //for from_chars
 #include <stdexcept>
-#include <iostream>
+#include <string>
+
+namespace {
+
+//Builds the pointer-linked tree in the Program's arena
+class TreeBuilder {
+public:
+    using Expr = Expression*;
+    using Stmt = Statement*;
+
+    explicit TreeBuilder(Program& program) : program(program), arena(program.arena) {}
+
+    Expr stringLiteral(std::string_view value, SourceOffset offset) {
+        return arena.make<StringLiteral>(arena.copyString(value), offset);
+    }
+    Expr numberLiteral(int value, SourceOffset offset) { return arena.make<NumberLiteral>(value, offset); }
+    Expr identifier(SymbolId name, SourceOffset offset) { return arena.make<Identifier>(name, offset); }
+    Expr binary(Expr left, BinaryOperator op, Expr right, SourceOffset offset) {
+        return arena.make<BinaryExpression>(left, op, right, offset);
+    }
+
+    Stmt block(const Stmt* statements, size_t count, SourceOffset offset) {
+        return arena.make<Block>(arena.copyArray(statements, count), offset);
+    }
+    Stmt ifStatement(Expr condition, Stmt thenBlock, Stmt elseBlock, SourceOffset offset) {
+        return arena.make<IfStatement>(condition, static_cast<Block*>(thenBlock), static_cast<Block*>(elseBlock), offset);
+    }
+    Stmt noBlock() const { return nullptr; }
+    Stmt variableDeclaration(SymbolId name, Expr value, SourceOffset offset) {
+        return arena.make<VariableDeclaration>(name, value, offset);
+    }
+    Stmt showStatement(Expr expression, SourceOffset offset) { return arena.make<ShowStatement>(expression, offset); }
+    Stmt assignmentStatement(SymbolId name, Expr value, SourceOffset offset) {
+        return arena.make<AssignmentStatement>(name, value, offset);
+    }
+
+    void addTopLevel(Stmt statement) { program.statements.push_back(statement); }
+
+private:
+    Program& program;
+    Arena& arena;
+};
+
+} // namespace
+
 //Parser class constructor
-Parser::Parser(const std::vector<Token>& tokens) : tokens(tokens), current(0) {}
+//The token vector always ends with EOF_TOKEN, so peek() never runs off the end
+Parser::Parser(const std::vector<Token>& tokens) : stream(tokens), maxDepth(kDefaultMaxDepth) {}
+
+Parser::Parser(const Token* tokens, size_t count, const Token& eof)
+    : stream(tokens, count, eof), maxDepth(kDefaultMaxDepth) {}
+
+Parser::Parser(Lexer& lexer) : stream(lexer), maxDepth(kDefaultMaxDepth) {}
 
 
 //main
 std::unique_ptr<Program> Parser::parse() {
     auto program = std::make_unique<Program>();
-    
-    while (!isAtEnd()) {
-        program->statements.push_back(parseStatement());
+    TreeBuilder builder(*program);
+    parseProgram(builder);
+    return program;
+}
+
+std::unique_ptr<Program> Parser::parseRecovering(std::vector<CompilerError>& diagnostics) {
+    auto program = std::make_unique<Program>();
+    TreeBuilder builder(*program);
+    try {
+        parseProgram(builder);
+    } catch (const CompilerErrorList& list) {
+        diagnostics.insert(diagnostics.end(), list.getErrors().begin(), list.getErrors().end());
     }
-    
     return program;
 }
 
-std::unique_ptr<Statement> Parser::parseStatement() {
+FlatAst Parser::parseFlat() {
+    FlatAst ast;
+    FlatAstBuilder builder(ast);
+    parseProgram(builder);
+    ast.shrinkToFit();
+    return ast;
+}
+
+//An operator waiting for its right operand; precedence 0 marks an open '('
+struct PendingOperator {
+    BinaryOperator op;
+    uint8_t precedence;
+    SourceOffset offset;
+};
+
+//The explicit stacks that stand in for recursion, kept for a whole parse so
+//their capacity is reused
+template <typename Builder>
+struct Parser::Stacks {
+    //An if statement whose then or else block is still being parsed
+    struct OpenIf {
+        SourceOffset ifOffset;
+        typename Builder::Expr condition;
+        typename Builder::Stmt thenBlock;
+        SourceOffset blockOffset; // '{' of the block being parsed
+        size_t firstStatement; // where that block's statements start in `statements`
+        bool inElse;
+    };
+
+    std::vector<typename Builder::Stmt> statements; // statements of every open block, innermost last
+    std::vector<OpenIf> ifs;
+    std::vector<typename Builder::Expr> operands;
+    std::vector<PendingOperator> operators;
+};
+
+//Statements are parsed in one loop: an if pushes an OpenIf and the loop
+//carries on inside its block; '}' pops it again
+//A ParserError drops the statement being parsed and the loop resynchronizes;
+//a LexerError ends the parse, since the token stream cannot continue past it
+template <typename Builder>
+void Parser::parseProgram(Builder& builder) {
+    Stacks<Builder> stacks;
+    errors.clear();
+    try {
+        while (true) {
+            try {
+                if (!stacks.ifs.empty() && check(TokenType::RIGHT_BRACE)) {
+                    closeBlock(builder, stacks);
+                } else if (isAtEnd()) {
+                    break;
+                } else if (match(TokenType::IF)) {
+                    openIf(builder, stacks);
+                } else {
+                    addStatement(builder, stacks, parseStatement(builder, stacks));
+                }
+            } catch (const ParserError& error) {
+                errors.report(error);
+                synchronize(stacks);
+            }
+        }
+        if (!stacks.ifs.empty()) {
+            const char* message = stacks.ifs.back().inElse ? "Expected '}' after else body" : "Expected '}' after if body";
+            errors.report(ParserError(message, peek().offset));
+        }
+    } catch (const LexerError& error) {
+        if (errors.empty()) {
+            throw;
+        }
+        errors.report(error);
+    }
+    errors.finish();
+}
+
+//Panic-mode recovery after an error: skips tokens up to and including the
+//next ';', or up to the '}' closing the enclosing block, or up to the next
+//statement keyword. A '{' (with any else branches after it) belongs to the
+//broken statement, so the whole braced group is skipped
+//The failed statement always consumed at least one token, so this makes progress
+template <typename Builder>
+void Parser::synchronize(Stacks<Builder>& stacks) {
+    while (!isAtEnd()) {
+        switch (peek().type) {
+            case TokenType::SEMICOLON:
+                advance();
+                return;
+            case TokenType::RIGHT_BRACE:
+                // A stray '}' at top level is part of the error; consume it
+                if (stacks.ifs.empty()) {
+                    advance();
+                }
+                return;
+            case TokenType::LET:
+            case TokenType::SHOW:
+            case TokenType::IF:
+                return;
+            case TokenType::LEFT_BRACE: {
+                size_t depth = 0;
+                do {
+                    if (check(TokenType::LEFT_BRACE)) {
+                        ++depth;
+                    } else if (check(TokenType::RIGHT_BRACE)) {
+                        --depth;
+                    }
+                    advance();
+                } while (depth > 0 && !isAtEnd());
+                if (!match(TokenType::ELSE)) {
+                    return;
+                }
+                break;
+            }
+            default:
+                advance();
+                break;
+        }
+    }
+}
+
+template <typename Builder>
+void Parser::addStatement(Builder& builder, Stacks<Builder>& stacks, typename Builder::Stmt statement) {
+    if (stacks.ifs.empty()) {
+        builder.addTopLevel(statement);
+    } else {
+        stacks.statements.push_back(statement);
+    }
+}
+
+template <typename Builder>
+typename Builder::Stmt Parser::parseStatement(Builder& builder, Stacks<Builder>& stacks) {
     if (match(TokenType::LET)) {
-        return parseVariableDeclaration();
+        return parseVariableDeclaration(builder, stacks);
     } else if (match(TokenType::SHOW)) {
-        return parseShowStatement();
-    } else if (match(TokenType::IF)) {
-        return parseIfStatement();
+        return parseShowStatement(builder, stacks);
     } else if (check(TokenType::IDENTIFIER)) {
         // Assignment statement
-        return parseAssignmentStatement();
+        return parseAssignmentStatement(builder, stacks);
     }
-    throw ParserError("Unexpected token: " + peek().value, peek().line, peek().column);
+    throw ParserError("Unexpected token: " + std::string(peek().value), peek().offset);
 }
 
-std::unique_ptr<Statement> Parser::parseIfStatement() {
+//Parses `if (condition) {` and opens its then block
+template <typename Builder>
+void Parser::openIf(Builder& builder, Stacks<Builder>& stacks) {
+    SourceOffset ifOffset = previous().offset;
+    if (stacks.ifs.size() >= maxDepth) {
+        throw ParserError("Nesting is too deep (limit is " + std::to_string(maxDepth) + ")", ifOffset);
+    }
     // Parse condition
     if (!match(TokenType::LEFT_PAREN)) {
-        throw ParserError("Expected '(' after 'if'", peek().line, peek().column);
+        throw ParserError("Expected '(' after 'if'", peek().offset);
     }
-    auto condition = parseExpression();
+    auto condition = parseExpression(builder, stacks);
     if (!match(TokenType::RIGHT_PAREN)) {
-        throw ParserError("Expected ')' after if condition", peek().line, peek().column);
+        throw ParserError("Expected ')' after if condition", peek().offset);
     }
     // Parse then block
+    SourceOffset thenOffset = peek().offset;
     if (!match(TokenType::LEFT_BRACE)) {
-        throw ParserError("Expected '{' before if body", peek().line, peek().column);
-    }
-    std::vector<std::unique_ptr<Statement>> thenStatements;
-    while (!check(TokenType::RIGHT_BRACE) && !isAtEnd()) {
-        thenStatements.push_back(parseStatement());
-    }
-    if (!match(TokenType::RIGHT_BRACE)) {
-        throw ParserError("Expected '}' after if body", peek().line, peek().column);
+        throw ParserError("Expected '{' before if body", peek().offset);
     }
-    auto thenBlock = std::make_unique<Block>(std::move(thenStatements));
-    // Parse else block if present
-    std::unique_ptr<Block> elseBlock = nullptr;
-    if (match(TokenType::ELSE)) {
-        if (!match(TokenType::LEFT_BRACE)) {
-            throw ParserError("Expected '{' before else body", peek().line, peek().column);
-        }
-        std::vector<std::unique_ptr<Statement>> elseStatements;
-        while (!check(TokenType::RIGHT_BRACE) && !isAtEnd()) {
-            elseStatements.push_back(parseStatement());
-        }
-        if (!match(TokenType::RIGHT_BRACE)) {
-            throw ParserError("Expected '}' after else body", peek().line, peek().column);
+    stacks.ifs.push_back({ifOffset, condition, builder.noBlock(), thenOffset, stacks.statements.size(), false});
+}
+
+//Consumes the '}' of the innermost open block; after a then block an else
+//block may follow, otherwise the if statement is complete
+template <typename Builder>
+void Parser::closeBlock(Builder& builder, Stacks<Builder>& stacks) {
+    advance();
+    auto& open = stacks.ifs.back();
+    auto block = builder.block(stacks.statements.data() + open.firstStatement,
+                               stacks.statements.size() - open.firstStatement, open.blockOffset);
+    stacks.statements.resize(open.firstStatement);
+
+    auto elseBlock = builder.noBlock();
+    bool missingElseBrace = false;
+    if (!open.inElse) {
+        open.thenBlock = block;
+        // Parse else block if present
+        if (match(TokenType::ELSE)) {
+            SourceOffset elseOffset = peek().offset;
+            if (match(TokenType::LEFT_BRACE)) {
+                open.inElse = true;
+                open.blockOffset = elseOffset;
+                return;
+            }
+            missingElseBrace = true;
         }
-        elseBlock = std::make_unique<Block>(std::move(elseStatements));
+    } else {
+        elseBlock = block;
+    }
+    auto statement = builder.ifStatement(open.condition, open.thenBlock, elseBlock, open.ifOffset);
+    stacks.ifs.pop_back();
+    addStatement(builder, stacks, statement);
+    // Reported once the if is closed, so recovery resumes outside it
+    if (missingElseBrace) {
+        throw ParserError("Expected '{' before else body", peek().offset);
     }
-    return std::make_unique<IfStatement>(std::move(condition), std::move(thenBlock), std::move(elseBlock));
 }
 
-std::unique_ptr<Statement> Parser::parseVariableDeclaration() {
+template <typename Builder>
+typename Builder::Stmt Parser::parseVariableDeclaration(Builder& builder, Stacks<Builder>& stacks) {
+    // Copied: in pull mode the ring slot is reused while the value is parsed
     Token name = consume(TokenType::IDENTIFIER, "Expected variable name");
     consume(TokenType::EQUALS, "Expected '=' after variable name");
-    auto value = parseExpression();
+    auto value = parseExpression(builder, stacks);
     consume(TokenType::SEMICOLON, "Expected ';' after variable declaration");
-    return std::make_unique<VariableDeclaration>(name.value, std::move(value));
+    return builder.variableDeclaration(name.symbol, value, name.offset);
 }
 
-std::unique_ptr<Statement> Parser::parseShowStatement() {
-    auto expr = parseExpression();
+template <typename Builder>
+typename Builder::Stmt Parser::parseShowStatement(Builder& builder, Stacks<Builder>& stacks) {
+    SourceOffset showOffset = previous().offset;
+    auto expr = parseExpression(builder, stacks);
     consume(TokenType::SEMICOLON, "Expected ';' after show statement");
-    return std::make_unique<ShowStatement>(std::move(expr));
+    return builder.showStatement(expr, showOffset);
 }
 
-std::unique_ptr<Statement> Parser::parseAssignmentStatement() {
+template <typename Builder>
+typename Builder::Stmt Parser::parseAssignmentStatement(Builder& builder, Stacks<Builder>& stacks) {
     Token name = consume(TokenType::IDENTIFIER, "Expected variable name");
     consume(TokenType::EQUALS, "Expected '=' in assignment");
-    auto value = parseExpression();
+    auto value = parseExpression(builder, stacks);
     consume(TokenType::SEMICOLON, "Expected ';' after assignment");
-    return std::make_unique<AssignmentStatement>(name.value, std::move(value));
-}
-
-std::unique_ptr<Expression> Parser::parseExpression() {
-    return parseComparison();
-}
-
-std::unique_ptr<Expression> Parser::parseComparison() {
-    auto expr = parseTerm();
-    
-    while (match(TokenType::GREATER_THAN) || match(TokenType::LESS_THAN) ||
-           match(TokenType::GREATER_EQUAL) || match(TokenType::LESS_EQUAL) ||
-           match(TokenType::EQUAL_EQUAL) || match(TokenType::NOT_EQUAL)) {
-        BinaryOperator op;
-        switch (previous().type) {
-            case TokenType::GREATER_THAN: op = BinaryOperator::GREATER_THAN; break;
-            case TokenType::LESS_THAN: op = BinaryOperator::LESS_THAN; break;
-            case TokenType::GREATER_EQUAL: op = BinaryOperator::GREATER_EQUAL; break;
-            case TokenType::LESS_EQUAL: op = BinaryOperator::LESS_EQUAL; break;
-            case TokenType::EQUAL_EQUAL: op = BinaryOperator::EQUAL_EQUAL; break;
-            case TokenType::NOT_EQUAL: op = BinaryOperator::NOT_EQUAL; break;
-            default: throw ParserError("Invalid comparison operator", previous().line, previous().column);
-        }
-        
-        auto right = parseTerm();
-        expr = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
-    }
-    
-    return expr;
+    return builder.assignmentStatement(name.symbol, value, name.offset);
 }
 
-std::unique_ptr<Expression> Parser::parseTerm() {
-    auto expr = parseFactor();
-    
-    while (match(TokenType::PLUS) || match(TokenType::MINUS)) {
-        BinaryOperator op = previous().type == TokenType::PLUS ? BinaryOperator::ADD : BinaryOperator::SUBTRACT;
-        auto right = parseFactor();
-        expr = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
-    }
-    
-    return expr;
-}
+//Precedence climbing with explicit operand and operator stacks instead of
+//recursion; binding strength and associativity come from one lookup in
+//parser_tables::binaryOperators per operator token
+template <typename Builder>
+typename Builder::Expr Parser::parseExpression(Builder& builder, Stacks<Builder>& stacks) {
+    auto& operands = stacks.operands;
+    auto& operators = stacks.operators;
+    operands.clear();
+    operators.clear();
 
-std::unique_ptr<Expression> Parser::parseFactor() {
-    auto expr = parsePrimary();
-    
-    while (match(TokenType::MULTIPLY) || match(TokenType::DIVIDE)) {
-        BinaryOperator op = previous().type == TokenType::MULTIPLY ? BinaryOperator::MULTIPLY : BinaryOperator::DIVIDE;
-        auto right = parsePrimary();
-        expr = std::make_unique<BinaryExpression>(std::move(expr), op, std::move(right));
-    }
-    
-    return expr;
-}
+    auto reduce = [&]() {
+        PendingOperator pending = operators.back();
+        operators.pop_back();
+        auto right = operands.back();
+        operands.pop_back();
+        operands.back() = builder.binary(operands.back(), pending.op, right, pending.offset);
+    };
 
-std::unique_ptr<Expression> Parser::parsePrimary() {
-    if (match(TokenType::STRING_LITERAL)) {
-        return std::make_unique<StringLiteral>(previous().value);
+    size_t openParens = 0;
+    while (true) {
+        // Operand position: any number of '(' and then a primary
+        while (match(TokenType::LEFT_PAREN)) {
+            if (stacks.ifs.size() + ++openParens > maxDepth) {
+                throw ParserError("Nesting is too deep (limit is " + std::to_string(maxDepth) + ")", previous().offset);
+            }
+            operators.push_back(PendingOperator{BinaryOperator::ADD, 0, previous().offset});
+        }
+        operands.push_back(parsePrimary(builder));
+
+        // Operator position: any number of ')' and then a binary operator or the end
+        while (openParens > 0 && check(TokenType::RIGHT_PAREN)) {
+            while (operators.back().precedence != 0) {
+                reduce();
+            }
+            operators.pop_back();
+            --openParens;
+            advance();
+        }
+        const Token& token = peek();
+        const parser_tables::BinaryOperatorInfo& info = parser_tables::binaryOperator(token.type);
+        if (info.precedence == 0) {
+            break;
+        }
+        // Pending operators that bind at least as tight take their right
+        // operand now: every binary operator is left-associative
+        while (!operators.empty() && operators.back().precedence >= info.precedence) {
+            reduce();
+        }
+        operators.push_back(PendingOperator{info.op, info.precedence, token.offset});
+        advance();
     }
-    
-    if (match(TokenType::NUMBER_LITERAL)) {
-        return std::make_unique<NumberLiteral>(std::stoi(previous().value));
+    if (openParens > 0) {
+        throw ParserError("Expected ')' after expression", peek().offset);
     }
-    
-    if (match(TokenType::IDENTIFIER)) {
-        return std::make_unique<Identifier>(previous().value);
+    while (!operators.empty()) {
+        reduce();
     }
+    auto result = operands.back();
+    operands.pop_back();
+    return result;
+}
 
-    // Add support for parenthesized expressions
-    if (match(TokenType::LEFT_PAREN)) {
-        auto expr = parseExpression();
-        consume(TokenType::RIGHT_PAREN, "Expected ')' after expression");
-        return expr;
+template <typename Builder>
+typename Builder::Expr Parser::parsePrimary(Builder& builder) {
+    const Token& token = peek();
+    switch (token.type) {
+        case TokenType::STRING_LITERAL:
+            advance();
+            return builder.stringLiteral(token.value, token.offset);
+        case TokenType::NUMBER_LITERAL: {
+            advance();
+            int value = 0;
+            auto result = std::from_chars(token.value.data(), token.value.data() + token.value.size(), value);
+            if (result.ec != std::errc()) {
+                throw ParserError("Number literal out of range: " + std::string(token.value), token.offset);
+            }
+            return builder.numberLiteral(value, token.offset);
+        }
+        case TokenType::IDENTIFIER:
+            advance();
+            return builder.identifier(token.symbol, token.offset);
+        default:
+            throw ParserError("Unexpected token in expression: " + std::string(token.value), token.offset);
     }
-    
-    throw ParserError("Unexpected token in expression: " + peek().value, peek().line, peek().column);
 }
 
 bool Parser::match(TokenType type) {
@@ -184,12 +406,12 @@ bool Parser::match(TokenType type) {
 }
 
 bool Parser::check(TokenType type) {
-    if (isAtEnd()) return false;
-    return peek().type == type;
+    TokenType next = peek().type;
+    return next == type && next != TokenType::EOF_TOKEN;
 }
 
-Token Parser::advance() {
-    if (!isAtEnd()) current++;
+const Token& Parser::advance() {
+    if (!isAtEnd()) stream.advance();
     return previous();
 }
 
@@ -197,20 +419,20 @@ bool Parser::isAtEnd() {
     return peek().type == TokenType::EOF_TOKEN;
 }
 
-Token Parser::peek() {
-    return tokens[current];
+const Token& Parser::peek() {
+    return stream.peek();
 }
 
-Token Parser::previous() {
-    return tokens[current - 1];
+const Token& Parser::previous() {
+    return stream.previous();
 }
 
 //consume token
-Token Parser::consume(TokenType type, const std::string& message) {
+const Token& Parser::consume(TokenType type, const char* message) {
     if (check(type)) {
-        Token token = advance();
-        std::cout << "[Parser] Consumed token: " << token.value << " (Type: " << static_cast<int>(token.type) << ")" << std::endl;
+        const Token& token = advance();
+        GEHU_LOG(PARSER, TRACE, "Consumed token: " << token.value << " (Type: " << static_cast<int>(token.type) << ")");
         return token;
     }
-    throw ParserError(message, peek().line, peek().column);
+    throw ParserError(message, peek().offset);
 } 
\ No newline at end of file
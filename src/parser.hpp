@@ -11,35 +11,68 @@
 #pragma once
 
 #include "lexer.hpp"
+#include "token_stream.hpp"
 #include "ast.hpp"
+#include "errors.hpp"
+#include "flat_ast.hpp"
 #include <vector>
 #include <memory>
 
+//Parser borrows the token storage; tokens must outlive the Parser
+//Constructed from a Lexer it pulls tokens on demand through a bounded ring
+//The grammar is written once against a Builder, which either allocates
+//tree nodes (parse) or appends to a flat AST (parseFlat)
+//Nothing recurses: open if blocks and pending operators live on explicit
+//stacks, so nesting depth is bounded only by maxDepth
+//A syntax error does not stop the parse: it is recorded, the rest of the
+//broken statement is skipped, and parsing resumes at the next one. parse()
+//then throws every error at once as a CompilerErrorList
 class Parser {
 public:
+    // Deepest nesting of if blocks and parentheses accepted by default
+    static constexpr size_t kDefaultMaxDepth = 1000000;
+
     explicit Parser(const std::vector<Token>& tokens);
+    Parser(std::vector<Token>&&) = delete;
+    // Parses tokens[0, count) as a whole program ending at eof
+    Parser(const Token* tokens, size_t count, const Token& eof);
+    explicit Parser(Lexer& lexer);
     std::unique_ptr<Program> parse();
+    FlatAst parseFlat();
+    // Like parse(), but returns the statements that survived recovery and
+    // leaves the syntax errors in diagnostics instead of throwing them.
+    // Tokens must come from an array
+    std::unique_ptr<Program> parseRecovering(std::vector<CompilerError>& diagnostics);
+
+    // Deeper nesting is reported as a ParserError
+    void setMaxDepth(size_t depth) { maxDepth = depth; }
+    // Parsing stops after this many errors; 0 means no limit
+    void setErrorLimit(size_t limit) { errors.setLimit(limit); }
 
 private:
-    std::vector<Token> tokens;
-    size_t current;
+    template <typename Builder> struct Stacks;
+
+    TokenStream stream;
+    size_t maxDepth;
+    ErrorCollector errors;
 
-    std::unique_ptr<Statement> parseStatement();
-    std::unique_ptr<Statement> parseVariableDeclaration();
-    std::unique_ptr<Statement> parseShowStatement();
-    std::unique_ptr<Statement> parseIfStatement();
-    std::unique_ptr<Statement> parseAssignmentStatement();
-    std::unique_ptr<Expression> parseExpression();
-    std::unique_ptr<Expression> parseComparison();
-    std::unique_ptr<Expression> parseTerm();
-    std::unique_ptr<Expression> parseFactor();
-    std::unique_ptr<Expression> parsePrimary();
+    template <typename Builder> void parseProgram(Builder& builder);
+    template <typename Builder> void addStatement(Builder& builder, Stacks<Builder>& stacks, typename Builder::Stmt statement);
+    template <typename Builder> typename Builder::Stmt parseStatement(Builder& builder, Stacks<Builder>& stacks);
+    template <typename Builder> void openIf(Builder& builder, Stacks<Builder>& stacks);
+    template <typename Builder> void closeBlock(Builder& builder, Stacks<Builder>& stacks);
+    template <typename Builder> void synchronize(Stacks<Builder>& stacks);
+    template <typename Builder> typename Builder::Stmt parseVariableDeclaration(Builder& builder, Stacks<Builder>& stacks);
+    template <typename Builder> typename Builder::Stmt parseShowStatement(Builder& builder, Stacks<Builder>& stacks);
+    template <typename Builder> typename Builder::Stmt parseAssignmentStatement(Builder& builder, Stacks<Builder>& stacks);
+    template <typename Builder> typename Builder::Expr parseExpression(Builder& builder, Stacks<Builder>& stacks);
+    template <typename Builder> typename Builder::Expr parsePrimary(Builder& builder);
     
     bool match(TokenType type);
     bool check(TokenType type);
-    Token advance();
+    const Token& advance();
     bool isAtEnd();
-    Token peek();
-    Token previous();
-    Token consume(TokenType type, const std::string& message);
-}; 
\ No newline at end of file
+    const Token& peek();
+    const Token& previous();
+    const Token& consume(TokenType type, const char* message);
+};
@@ -0,0 +1,56 @@
+//
+//Compile-time tables that drive Parser::parseExpression
+//binaryOperators maps every TokenType to the binary operator it spells, with
+//its binding strength; one lookup per token decides whether
+//an expression continues. A new precedence level is a new row here
+#pragma once
+
+#include "ast.hpp"
+#include "lexer.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace parser_tables {
+
+constexpr size_t kTokenTypeCount = static_cast<size_t>(TokenType::ERROR) + 1;
+
+struct BinaryOperatorInfo {
+    uint8_t precedence; // higher binds tighter; 0 when the token is no binary operator
+    BinaryOperator op;
+};
+
+constexpr std::array<BinaryOperatorInfo, kTokenTypeCount> buildBinaryOperators() {
+    std::array<BinaryOperatorInfo, kTokenTypeCount> table{};
+    for (auto& entry : table) {
+        entry = BinaryOperatorInfo{0, BinaryOperator::ADD};
+    }
+    auto set = [&table](TokenType type, uint8_t precedence, BinaryOperator op) {
+        table[static_cast<size_t>(type)] = BinaryOperatorInfo{precedence, op};
+    };
+    // Comparisons bind loosest, then + and -, then * and /
+    set(TokenType::GREATER_THAN, 1, BinaryOperator::GREATER_THAN);
+    set(TokenType::LESS_THAN, 1, BinaryOperator::LESS_THAN);
+    set(TokenType::GREATER_EQUAL, 1, BinaryOperator::GREATER_EQUAL);
+    set(TokenType::LESS_EQUAL, 1, BinaryOperator::LESS_EQUAL);
+    set(TokenType::EQUAL_EQUAL, 1, BinaryOperator::EQUAL_EQUAL);
+    set(TokenType::NOT_EQUAL, 1, BinaryOperator::NOT_EQUAL);
+    set(TokenType::PLUS, 2, BinaryOperator::ADD);
+    set(TokenType::MINUS, 2, BinaryOperator::SUBTRACT);
+    set(TokenType::MULTIPLY, 3, BinaryOperator::MULTIPLY);
+    set(TokenType::DIVIDE, 3, BinaryOperator::DIVIDE);
+    return table;
+}
+
+inline constexpr std::array<BinaryOperatorInfo, kTokenTypeCount> binaryOperators = buildBinaryOperators();
+
+constexpr const BinaryOperatorInfo& binaryOperator(TokenType type) {
+    return binaryOperators[static_cast<size_t>(type)];
+}
+
+static_assert(binaryOperator(TokenType::MULTIPLY).precedence > binaryOperator(TokenType::PLUS).precedence &&
+              binaryOperator(TokenType::PLUS).precedence > binaryOperator(TokenType::LESS_THAN).precedence &&
+              binaryOperator(TokenType::SEMICOLON).precedence == 0 && binaryOperator(TokenType::EOF_TOKEN).precedence == 0,
+              "binary operator table is inconsistent");
+
+} // namespace parser_tables
@@ -0,0 +1,113 @@
+#include "perf_counters.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+struct EventSpec {
+    const char* name;
+    uint32_t type;
+    uint64_t config;
+};
+
+constexpr uint64_t cacheEvent(uint64_t cache, uint64_t result) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (result << 16);
+}
+
+// Indexed by PerfCounters::Event
+constexpr EventSpec kEventSpecs[] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"branches", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS},
+    {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {"l1d_loads", PERF_TYPE_HW_CACHE, cacheEvent(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_RESULT_ACCESS)},
+    {"l1d_load_misses", PERF_TYPE_HW_CACHE, cacheEvent(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_RESULT_MISS)},
+    {"llc_references", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES},
+    {"llc_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+};
+static_assert(std::size(kEventSpecs) == PerfCounters::kEvents, "an event has no spec");
+
+std::string describeError(int error) {
+    switch (error) {
+        case ENOENT:
+        case EOPNOTSUPP:
+            return "not supported by this CPU or virtual machine";
+        case EACCES:
+        case EPERM:
+            return "not permitted; see /proc/sys/kernel/perf_event_paranoid";
+        case ENOSYS:
+            return "perf_event_open is not available";
+        default:
+            return std::strerror(error);
+    }
+}
+
+} // namespace
+
+PerfCounters::PerfCounters() {
+    std::fill(std::begin(descriptors), std::end(descriptors), -1);
+}
+
+PerfCounters::~PerfCounters() {
+    for (int descriptor : descriptors) {
+        if (descriptor >= 0) {
+            close(descriptor);
+        }
+    }
+}
+
+bool PerfCounters::open() {
+    for (size_t i = 0; i < kEvents; ++i) {
+        if (descriptors[i] >= 0) {
+            continue;
+        }
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = kEventSpecs[i].type;
+        attr.config = kEventSpecs[i].config;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        long descriptor = syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+        if (descriptor < 0) {
+            if (openError.empty()) {
+                openError = std::string(kEventSpecs[i].name) + ": " + describeError(errno);
+            }
+            continue;
+        }
+        descriptors[i] = static_cast<int>(descriptor);
+    }
+    return anyAvailable();
+}
+
+bool PerfCounters::anyAvailable() const {
+    return std::any_of(std::begin(descriptors), std::end(descriptors), [](int descriptor) { return descriptor >= 0; });
+}
+
+void PerfCounters::read(uint64_t* counts) const {
+    for (size_t i = 0; i < kEvents; ++i) {
+        counts[i] = 0;
+        uint64_t values[3]; // value, time enabled, time running
+        if (descriptors[i] < 0 || ::read(descriptors[i], values, sizeof(values)) != sizeof(values)) {
+            continue;
+        }
+        if (values[2] == 0) {
+            continue; // never got a hardware counter
+        }
+        counts[i] = values[2] < values[1]
+                        ? static_cast<uint64_t>(static_cast<double>(values[0]) * values[1] / values[2])
+                        : values[0];
+    }
+}
+
+const char* PerfCounters::eventName(Event event) {
+    return kEventSpecs[static_cast<size_t>(event)].name;
+}
@@ -0,0 +1,48 @@
+//
+//PerfCounters: the CPU's hardware event counters, through perf_event_open
+//Each event is opened on its own for the whole process, user space only, and
+//threads started later are counted too once they exit. Events the kernel
+//multiplexes are scaled by the share of time they were counting
+//Any event may be missing: containers and virtual machines often have no
+//PMU, and perf_event_paranoid can forbid the call
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class PerfCounters {
+public:
+    enum class Event {
+        CYCLES,
+        INSTRUCTIONS,
+        BRANCHES,
+        BRANCH_MISSES,
+        L1D_LOADS,
+        L1D_LOAD_MISSES,
+        LLC_REFERENCES,
+        LLC_MISSES,
+        COUNT
+    };
+    static constexpr size_t kEvents = static_cast<size_t>(Event::COUNT);
+
+    PerfCounters();
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+    ~PerfCounters();
+
+    // Opens every event it can and starts counting; false when none opened
+    bool open();
+    bool available(Event event) const { return descriptors[static_cast<size_t>(event)] >= 0; }
+    bool anyAvailable() const;
+    // Why the first event that failed could not be opened
+    const std::string& error() const { return openError; }
+    // Running totals; 0 for events that are not available
+    void read(uint64_t* counts) const;
+
+    static const char* eventName(Event event);
+
+private:
+    int descriptors[kEvents]; // -1 where the event is not open
+    std::string openError;
+};
@@ -1,31 +1,107 @@
 #include "ast.hpp"
 #include "semantic_analyzer.hpp"
 #include "errors.hpp"
+#include <algorithm>
+
+SemanticAnalyzer::SemanticAnalyzer(const StringInterner& symbols) : symbols(symbols) {}
 
 void SemanticAnalyzer::analyze(Program* program) {
-    for (const auto& statement : program->statements) {
-        statement->accept(*this);
+    variables.reset(symbols.size());
+    errors.clear();
+    marks.clear();
+    analyzeStatements(program, 0);
+}
+
+void SemanticAnalyzer::reanalyze(Program* program, size_t first) {
+    if (marks.empty()) {
+        analyze(program);
+        return;
     }
+    // A run cut short by the error limit can only resume where it stopped
+    first = std::min(first, marks.size() - 1);
+    variables.grow(symbols.size());
+    variables.rollback(marks[first].declarations);
+    errors.truncate(marks[first].errors);
+    marks.resize(first);
+    analyzeStatements(program, first);
 }
 
-void SemanticAnalyzer::visitStringLiteral(StringLiteral* node) {
-    // String literals are always valid
+void SemanticAnalyzer::analyzeStatements(Program* program, size_t first) {
+    for (size_t i = first; i < program->statements.size(); ++i) {
+        marks.push_back(StatementMark{variables.mark(), errors.size()});
+        walk(program->statements[i]);
+    }
+    marks.push_back(StatementMark{variables.mark(), errors.size()});
+    errors.finish();
 }
 
-void SemanticAnalyzer::visitNumberLiteral(NumberLiteral* node) {
-    // Number literals are always valid
+// Same checks as the tree hooks, in the same order, over the flat AST
+struct SemanticAnalyzer::FlatPass {
+    SemanticAnalyzer& analyzer;
+    const FlatAst& ast;
+
+    void enterBlock(NodeIndex) { analyzer.variables.enterScope(); }
+    void exitBlock(NodeIndex) { analyzer.variables.exitScope(); }
+    void enterIf(NodeIndex node) { analyzer.analyzeFlatExpression(ast, ast.ifs[ast.a[node]].condition); }
+    void beforeElse(NodeIndex) {}
+    void exitIf(NodeIndex) {}
+    void statement(NodeIndex node) { analyzer.analyzeFlatStatement(ast, node); }
+};
+
+void SemanticAnalyzer::analyze(const FlatAst& ast) {
+    variables.reset(symbols.size());
+    errors.clear();
+    FlatPass pass{*this, ast};
+    for (NodeIndex statement : ast.statements) {
+        walkFlatStatements(ast, statement, pass, flatStack);
+    }
+    errors.finish();
+}
+
+// Declarations, shows and assignments; blocks and ifs are walkFlatStatements' job
+void SemanticAnalyzer::analyzeFlatStatement(const FlatAst& ast, NodeIndex statement) {
+    switch (ast.kinds[statement]) {
+        case FlatKind::VARIABLE_DECLARATION:
+            if (isDeclared(ast.a[statement])) {
+                errors.report(SemanticError("Variable already declared: " + nameOf(ast.a[statement]), ast.offsets[statement]));
+            }
+            analyzeFlatExpression(ast, ast.expression(statement));
+            if (!isDeclared(ast.a[statement])) {
+                variables.declare(ast.a[statement]);
+            }
+            break;
+        case FlatKind::SHOW:
+            analyzeFlatExpression(ast, ast.expression(statement));
+            break;
+        case FlatKind::ASSIGNMENT:
+            if (!isDeclared(ast.a[statement])) {
+                errors.report(SemanticError("Assignment to undeclared variable: " + nameOf(ast.a[statement]), ast.offsets[statement]));
+            }
+            analyzeFlatExpression(ast, ast.expression(statement));
+            break;
+        default:
+            break;
+    }
+}
+
+// Post-order keeps identifiers in source order, so a linear sweep reports
+// the same errors in the same order as the tree walk
+void SemanticAnalyzer::analyzeFlatExpression(const FlatAst& ast, FlatExpression expression) {
+    for (NodeIndex node = expression.first; node <= expression.root; ++node) {
+        if (ast.kinds[node] == FlatKind::IDENTIFIER && !isDeclared(ast.a[node])) {
+            errors.report(SemanticError("Undefined variable: " + nameOf(ast.a[node]), ast.offsets[node]));
+        }
+    }
 }
 
 void SemanticAnalyzer::visitIdentifier(Identifier* node) {
-    if (variables.find(node->name) == variables.end()) {
-        throw SemanticError("Undefined variable: " + node->name, 0, 0);
+    if (!isDeclared(node->name)) {
+        errors.report(SemanticError("Undefined variable: " + nameOf(node->name), node->offset));
     }
 }
 
+// Runs after both operands have been checked
 void SemanticAnalyzer::visitBinaryExpression(BinaryExpression* node) {
-    node->left->accept(*this);
-    node->right->accept(*this);
-    
     // Check for valid comparison operations
     switch (node->op) {
         case BinaryOperator::GREATER_THAN:
@@ -45,54 +121,38 @@ void SemanticAnalyzer::visitBinaryExpression(BinaryExpression* node) {
     }
 }
 
-void SemanticAnalyzer::visitBlock(Block* node) {
+bool SemanticAnalyzer::enterBlock(Block* node) {
     // Create a new scope for the block
-    std::map<std::string, bool> oldVariables = variables;
-    
-    // Analyze statements in the block
-    for (const auto& statement : node->statements) {
-        statement->accept(*this);
-    }
-    
-    // Restore the old scope
-    variables = oldVariables;
+    variables.enterScope();
+    return true;
 }
 
-void SemanticAnalyzer::visitIfStatement(IfStatement* node) {
-    // Analyze the condition
-    node->condition->accept(*this);
-    
-    // Analyze the then block
-    node->thenBlock->accept(*this);
-    
-    // Analyze the else block if present
-    if (node->elseBlock) {
-        node->elseBlock->accept(*this);
-    }
+void SemanticAnalyzer::exitBlock(Block* node) {
+    // Drop the block's declarations
+    variables.exitScope();
 }
 
-void SemanticAnalyzer::visitVariableDeclaration(VariableDeclaration* node) {
+bool SemanticAnalyzer::enterVariableDeclaration(VariableDeclaration* node) {
     // Check if variable is already declared
-    if (variables.find(node->name) != variables.end()) {
-        throw SemanticError("Variable already declared: " + node->name, 0, 0);
+    if (isDeclared(node->name)) {
+        errors.report(SemanticError("Variable already declared: " + nameOf(node->name), node->offset));
     }
-    
-    // Analyze the initializer expression
-    node->value->accept(*this);
-    
-    // Add variable to current scope
-    variables[node->name] = true; // Track declared variable
+    // The initializer expression is walked next
+    return true;
 }
 
-void SemanticAnalyzer::visitShowStatement(ShowStatement* node) {
-    node->expression->accept(*this);
+void SemanticAnalyzer::exitVariableDeclaration(VariableDeclaration* node) {
+    // Add variable to current scope; a redeclaration keeps the first one
+    if (!isDeclared(node->name)) {
+        variables.declare(node->name); // Track declared variable
+    }
 }
 
-void SemanticAnalyzer::visitAssignmentStatement(AssignmentStatement* node) {
+bool SemanticAnalyzer::enterAssignmentStatement(AssignmentStatement* node) {
     // Check if variable is declared
-    if (variables.find(node->name) == variables.end()) {
-        throw SemanticError("Assignment to undeclared variable: " + node->name, 0, 0);
+    if (!isDeclared(node->name)) {
+        errors.report(SemanticError("Assignment to undeclared variable: " + nameOf(node->name), node->offset));
     }
-    // Analyze the assigned value
-    node->value->accept(*this);
-} 
+    // The assigned value is walked next
+    return true;
+}
@@ -1,24 +1,60 @@
 #pragma once
 
 #include "ast_visitor.hpp"
-#include <map>//for symbol table
-#include <string>//for variable names
+#include "errors.hpp"
+#include "flat_ast.hpp"
+#include "interner.hpp"//for SymbolId
+#include "symbol_table.hpp"
+#include <string>//for error messages
+#include <vector>
 
-class SemanticAnalyzer : public ASTVisitor {
+//Errors do not stop the analysis: each one is recorded and the walk carries
+//on, and analyze() throws them all at the end as a CompilerErrorList
+//analyze(Program*) also notes the symbol table and error count at the start
+//of every top-level statement, so reanalyze() can redo just a program's tail
+class SemanticAnalyzer : public ASTVisitor<SemanticAnalyzer> {
 public:
+    explicit SemanticAnalyzer(const StringInterner& symbols);
+
     //entry point
     void analyze(Program* program);
+    void analyze(const FlatAst& ast);
+    //Analyzes program again from top-level statement first on; the statements
+    //before it must be the ones the last analyze or reanalyze saw
+    void reanalyze(Program* program, size_t first);
+
+    //Analysis stops after this many errors; 0 means no limit
+    void setErrorLimit(size_t limit) { errors.setLimit(limit); }
     
-    void visitStringLiteral(StringLiteral* node) override;
-    void visitNumberLiteral(NumberLiteral* node) override;
-    void visitIdentifier(Identifier* node) override;
-    void visitBinaryExpression(BinaryExpression* node) override;
-    void visitBlock(Block* node) override;
-    void visitIfStatement(IfStatement* node) override;
-    void visitVariableDeclaration(VariableDeclaration* node) override;
-    void visitShowStatement(ShowStatement* node) override;
-    void visitAssignmentStatement(AssignmentStatement* node) override;
+    //ASTVisitor hooks
+    void visitIdentifier(Identifier* node);
+    void visitBinaryExpression(BinaryExpression* node);
+    bool enterBlock(Block* node);
+    void exitBlock(Block* node);
+    bool enterVariableDeclaration(VariableDeclaration* node);
+    void exitVariableDeclaration(VariableDeclaration* node);
+    bool enterAssignmentStatement(AssignmentStatement* node);
 
 private:
-    std::map<std::string, bool> variables;
-}; 
\ No newline at end of file
+    struct FlatPass; // walkFlatStatements visitor
+
+    //Where the analysis stood when a top-level statement was reached
+    struct StatementMark {
+        size_t declarations; // symbol table undo log position
+        size_t errors;
+    };
+
+    const StringInterner& symbols;
+    ScopedSymbolTable variables;
+    ErrorCollector errors;
+    std::vector<FlatFrame> flatStack;
+    std::vector<StatementMark> marks; // one per statement reached, plus one for the end
+
+    void analyzeStatements(Program* program, size_t first);
+
+    void analyzeFlatStatement(const FlatAst& ast, NodeIndex statement);
+    void analyzeFlatExpression(const FlatAst& ast, FlatExpression expression);
+
+    bool isDeclared(SymbolId name) const { return variables.isDeclared(name); }
+    std::string nameOf(SymbolId name) const { return std::string(symbols.name(name)); }
+};
@@ -0,0 +1,20 @@
+#include "source_location.hpp"
+#include "lexer_simd.hpp" //for findNewline
+#include <algorithm> //for upper_bound
+
+LineTable::LineTable(std::string_view text) {
+    const lexer_simd::Kernels& kernels = lexer_simd::active();
+    const char* begin = text.data();
+    const char* end = begin + text.size();
+    lineStarts.push_back(0);
+    for (const char* p = kernels.findNewline(begin, end); p != end; p = kernels.findNewline(p + 1, end)) {
+        lineStarts.push_back(static_cast<SourceOffset>(p + 1 - begin));
+    }
+}
+
+LineColumn LineTable::resolve(SourceOffset offset) const {
+    // Last line starting at or before offset
+    auto next = std::upper_bound(lineStarts.begin(), lineStarts.end(), offset);
+    size_t line = static_cast<size_t>(next - lineStarts.begin());
+    return LineColumn{static_cast<uint32_t>(line), offset - lineStarts[line - 1] + 1};
+}
@@ -0,0 +1,32 @@
+//
+//Source locations
+//Tokens, AST nodes and errors record a position as a single 32-bit byte
+//offset into the source buffer; line and column are only worked out when a
+//diagnostic is printed, through a LineTable built on first use
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+using SourceOffset = uint32_t;
+constexpr SourceOffset kNoOffset = UINT32_MAX; // no position (internal errors)
+constexpr size_t kMaxSourceSize = UINT32_MAX - 1; // largest buffer offsets can address
+
+//1-based line and column; column counts bytes
+struct LineColumn {
+    uint32_t line;
+    uint32_t column;
+};
+
+//Start offset of every line, found with the SIMD newline kernel
+class LineTable {
+public:
+    explicit LineTable(std::string_view text);
+
+    LineColumn resolve(SourceOffset offset) const;
+    size_t lineCount() const { return lineStarts.size(); }
+
+private:
+    std::vector<SourceOffset> lineStarts; // lineStarts[0] == 0
+};
@@ -0,0 +1,98 @@
+#include "source_manager.hpp"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h> //for open
+#include <sys/mman.h> //for mmap, munmap, madvise
+#include <sys/stat.h> //for fstat
+#include <unistd.h> //for read, close
+
+SourceBuffer::~SourceBuffer() {
+    if (mapped) {
+        munmap(const_cast<char*>(data), size);
+    }
+}
+
+LineColumn SourceBuffer::location(SourceOffset offset) const {
+    if (!lines) {
+        lines.reset(new LineTable(text()));
+    }
+    return lines->resolve(offset);
+}
+
+const SourceBuffer& SourceManager::load(const std::string& filename) {
+    std::unique_ptr<SourceBuffer> buffer(new SourceBuffer(filename));
+
+    if (filename == "-") {
+        readStream(STDIN_FILENO, *buffer);
+    } else {
+        int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error("Could not open file: " + filename);
+        }
+        try {
+            if (!mapFile(fd, *buffer)) {
+                readStream(fd, *buffer);
+            }
+        } catch (...) {
+            close(fd);
+            throw;
+        }
+        // The mapping stays valid after the descriptor is closed
+        close(fd);
+    }
+
+    buffers.push_back(std::move(buffer));
+    return *buffers.back();
+}
+
+bool SourceManager::mapFile(int fd, SourceBuffer& buffer) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+    if (st.st_size == 0) {
+        // mmap rejects zero-length mappings; an empty view is all we need
+        return true;
+    }
+
+    size_t size = static_cast<size_t>(st.st_size);
+    void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+        return false;
+    }
+    // The lexer walks the buffer front to back exactly once
+    madvise(addr, size, MADV_SEQUENTIAL);
+
+    buffer.data = static_cast<const char*>(addr);
+    buffer.size = size;
+    buffer.mapped = true;
+    return true;
+}
+
+void SourceManager::readStream(int fd, SourceBuffer& buffer) {
+    std::string& storage = buffer.storage;
+    size_t used = 0;
+    storage.resize(64 * 1024);
+
+    while (true) {
+        if (used == storage.size()) {
+            storage.resize(storage.size() * 2);
+        }
+        ssize_t n = read(fd, &storage[used], storage.size() - used);
+        if (n == 0) {
+            break;
+        }
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("Could not read file: " + buffer.name + ": " + std::strerror(errno));
+        }
+        used += static_cast<size_t>(n);
+    }
+
+    storage.resize(used);
+    buffer.data = storage.data();
+    buffer.size = storage.size();
+}
@@ -0,0 +1,54 @@
+//
+//SourceManager class definition
+//SourceManager owns the bytes of every input file for the whole compile
+//Regular files are memory-mapped read-only, so the source is never copied
+//Pipes, character devices and stdin ("-") fall back to a streaming read
+//The Lexer only ever receives a non-owning std::string_view of a buffer
+#pragma once
+
+#include "source_location.hpp"
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class SourceBuffer {
+public:
+    SourceBuffer(const SourceBuffer&) = delete;
+    SourceBuffer& operator=(const SourceBuffer&) = delete;
+    ~SourceBuffer();
+
+    std::string_view text() const { return std::string_view(data, size); }
+    const std::string& getName() const { return name; }
+    bool isMapped() const { return mapped; }
+
+    // Line and column of an offset; the line table is built on the first call
+    LineColumn location(SourceOffset offset) const;
+
+private:
+    friend class SourceManager;
+    explicit SourceBuffer(const std::string& name) : name(name) {}
+
+    std::string name;
+    const char* data = nullptr;
+    size_t size = 0;
+    bool mapped = false; // true when data points into an mmap region
+    std::string storage; // backing bytes for the streaming-read fallback
+    mutable std::unique_ptr<LineTable> lines; // only needed for diagnostics
+};
+
+class SourceManager {
+public:
+    SourceManager() = default;
+    SourceManager(const SourceManager&) = delete;
+    SourceManager& operator=(const SourceManager&) = delete;
+
+    // Loads a file ("-" reads stdin); the buffer lives as long as the manager
+    const SourceBuffer& load(const std::string& filename);
+
+private:
+    std::vector<std::unique_ptr<SourceBuffer>> buffers;
+
+    static bool mapFile(int fd, SourceBuffer& buffer);
+    static void readStream(int fd, SourceBuffer& buffer);
+};
@@ -0,0 +1,319 @@
+#include "stats.hpp"
+#include "ast_visitor.hpp"
+#include <llvm/IR/Module.h>
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <sys/resource.h> //for getrusage
+#include <time.h> //for clock_gettime
+#include <unistd.h> //for sysconf
+
+namespace {
+
+constexpr const char* kPhaseNames[] = {"read", "lex", "parse", "sema", "codegen", "verify", "optimize", "jit_setup",
+                                       "execute"};
+constexpr const char* kNodeNames[] = {"string_literal", "number_literal", "identifier", "binary_expression", "block",
+                                      "if_statement", "variable_declaration", "show_statement", "assignment_statement"};
+static_assert(std::size(kPhaseNames) == static_cast<size_t>(Stats::Phase::COUNT), "a phase has no name");
+static_assert(std::size(kNodeNames) == Stats::kNodeKinds, "a node kind has no name");
+
+double seconds(clockid_t clock) {
+    timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//Counts every node of a tree by kind
+class NodeCounter : public ASTVisitor<NodeCounter> {
+public:
+    explicit NodeCounter(uint64_t* nodes) : nodes(nodes) {}
+
+    void visitStringLiteral(StringLiteral* node) { count(node->kind); }
+    void visitNumberLiteral(NumberLiteral* node) { count(node->kind); }
+    void visitIdentifier(Identifier* node) { count(node->kind); }
+    void visitBinaryExpression(BinaryExpression* node) { count(node->kind); }
+    bool enterBlock(Block* node) { return count(node->kind); }
+    bool enterIfStatement(IfStatement* node) { return count(node->kind); }
+    bool enterVariableDeclaration(VariableDeclaration* node) { return count(node->kind); }
+    bool enterShowStatement(ShowStatement* node) { return count(node->kind); }
+    bool enterAssignmentStatement(AssignmentStatement* node) { return count(node->kind); }
+
+private:
+    uint64_t* nodes;
+
+    bool count(NodeKind kind) {
+        ++nodes[static_cast<size_t>(kind)];
+        return true;
+    }
+};
+
+std::string milliseconds(double value) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.3f", value * 1e3);
+    return text;
+}
+
+double mebibytes(double bytes) {
+    return bytes / (1024.0 * 1024.0);
+}
+
+// The heap report's name for a heap_profile slot
+const char* slotName(size_t slot) {
+    return slot < std::size(kPhaseNames) ? kPhaseNames[slot] : "other";
+}
+
+// part of whole as a percentage, or n/a
+std::string percent(uint64_t part, uint64_t whole, bool known) {
+    if (!known || whole == 0) {
+        return "n/a";
+    }
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.2f%%", 100.0 * part / whole);
+    return text;
+}
+
+// Slots the heap report lists: every phase, then kOutside
+std::vector<size_t> reportedSlots() {
+    std::vector<size_t> slots;
+    for (size_t i = 0; i < std::size(kPhaseNames); ++i) {
+        slots.push_back(i);
+    }
+    slots.push_back(heap_profile::kOutside);
+    return slots;
+}
+
+} // namespace
+
+Stats::Time Stats::now() {
+    return Time{seconds(CLOCK_MONOTONIC), seconds(CLOCK_PROCESS_CPUTIME_ID)};
+}
+
+//Reads /proc/self/statm; 0 where it is missing
+uint64_t Stats::residentBytes() {
+    std::FILE* file = std::fopen("/proc/self/statm", "r");
+    if (!file) {
+        return 0;
+    }
+    unsigned long long size = 0;
+    unsigned long long pages = 0;
+    int fields = std::fscanf(file, "%llu %llu", &size, &pages);
+    std::fclose(file);
+    return fields == 2 ? pages * static_cast<uint64_t>(sysconf(_SC_PAGESIZE)) : 0;
+}
+
+uint64_t Stats::peakResidentBytes() {
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024; // reported in KiB
+}
+
+const char* Stats::phaseName(Phase phase) {
+    return kPhaseNames[static_cast<size_t>(phase)];
+}
+
+void Stats::add(Phase phase, const Time& time) {
+    Time& total = times[static_cast<size_t>(phase)];
+    total.wall += time.wall;
+    total.cpu += time.cpu;
+}
+
+void Stats::addEvents(Phase phase, const uint64_t* start, const uint64_t* end) {
+    uint64_t* total = events[static_cast<size_t>(phase)];
+    for (size_t i = 0; i < PerfCounters::kEvents; ++i) {
+        total[i] += end[i] > start[i] ? end[i] - start[i] : 0; // scaled counts can step back
+    }
+}
+
+void Stats::countNodes(const Program& program) {
+    std::fill(std::begin(counters.nodes), std::end(counters.nodes), 0);
+    NodeCounter counter(counters.nodes);
+    for (Statement* statement : program.statements) {
+        counter.walk(statement);
+    }
+}
+
+//FlatKind lists the kinds in NodeKind's order
+void Stats::countNodes(const FlatAst& ast) {
+    std::fill(std::begin(counters.nodes), std::end(counters.nodes), 0);
+    for (FlatKind kind : ast.kinds) {
+        ++counters.nodes[static_cast<size_t>(kind)];
+    }
+}
+
+void Stats::countIr(const llvm::Module& module) {
+    counters.irFunctions = 0;
+    counters.irBasicBlocks = 0;
+    counters.irInstructions = 0;
+    for (const llvm::Function& function : module) {
+        if (function.isDeclaration()) {
+            continue;
+        }
+        ++counters.irFunctions;
+        for (const llvm::BasicBlock& block : function) {
+            ++counters.irBasicBlocks;
+            counters.irInstructions += block.size();
+        }
+    }
+}
+
+void Stats::print(std::ostream& out) const {
+    char line[128];
+    std::snprintf(line, sizeof(line), "%-28s %12s %12s %12s\n", "Phase", "Wall (ms)", "CPU (ms)", "RSS (MiB)");
+    out << line;
+    Time total;
+    for (size_t i = 0; i < std::size(kPhaseNames); ++i) {
+        std::snprintf(line, sizeof(line), "%-28s %12.3f %12.3f %12.1f\n", kPhaseNames[i], times[i].wall * 1e3,
+                      times[i].cpu * 1e3, mebibytes(resident[i]));
+        out << line;
+        total.wall += times[i].wall;
+        total.cpu += times[i].cpu;
+    }
+    // The total's RSS is the high-water mark
+    std::snprintf(line, sizeof(line), "%-28s %12.3f %12.3f %12.1f\n", "total", total.wall * 1e3, total.cpu * 1e3,
+                  mebibytes(peakResidentBytes()));
+    out << line;
+
+    if (heapProfiled) {
+        std::snprintf(line, sizeof(line), "\n%-28s %12s %12s %12s %12s %12s\n", "Heap", "Allocations", "Alloc (MiB)",
+                      "Frees", "Net (MiB)", "Peak (MiB)");
+        out << line;
+        heap_profile::Counters sum;
+        for (size_t slot : reportedSlots()) {
+            heap_profile::Counters heap = heap_profile::counters(slot);
+            std::snprintf(line, sizeof(line), "%-28s %12llu %12.1f %12llu %12.1f %12.1f\n", slotName(slot),
+                          static_cast<unsigned long long>(heap.allocations), mebibytes(heap.bytes),
+                          static_cast<unsigned long long>(heap.frees), mebibytes(heap.net), mebibytes(heap.peak));
+            out << line;
+            sum.allocations += heap.allocations;
+            sum.bytes += heap.bytes;
+            sum.frees += heap.frees;
+            sum.net += heap.net;
+            sum.peak = std::max(sum.peak, heap.peak);
+        }
+        std::snprintf(line, sizeof(line), "%-28s %12llu %12.1f %12llu %12.1f %12.1f\n", "total",
+                      static_cast<unsigned long long>(sum.allocations), mebibytes(sum.bytes),
+                      static_cast<unsigned long long>(sum.frees), mebibytes(sum.net), mebibytes(sum.peak));
+        out << line;
+    }
+    if (perf) {
+        printEvents(out);
+    }
+
+    auto counter = [&](const std::string& name, uint64_t value) {
+        std::snprintf(line, sizeof(line), "%-28s %12llu\n", name.c_str(), static_cast<unsigned long long>(value));
+        out << line;
+    };
+    out << "\nCounter\n";
+    counter("source_bytes", counters.sourceBytes);
+    counter("tokens", counters.tokens);
+    counter("symbols", counters.symbols);
+    for (size_t i = 0; i < kNodeKinds; ++i) {
+        counter(std::string("nodes.") + kNodeNames[i], counters.nodes[i]);
+    }
+    counter("ir_functions", counters.irFunctions);
+    counter("ir_basic_blocks", counters.irBasicBlocks);
+    counter("ir_instructions", counters.irInstructions);
+    counter("machine_code_bytes", counters.machineCodeBytes);
+    counter("peak_rss_bytes", peakResidentBytes());
+}
+
+//Version 2 layout (2 added the optimize phase); add keys at the end of an
+//object rather than renaming
+void Stats::printJson(std::ostream& out) const {
+    out << "{\"version\":2,\"phases\":{";
+    for (size_t i = 0; i < std::size(kPhaseNames); ++i) {
+        out << (i ? "," : "") << "\"" << kPhaseNames[i] << "\":{\"wall_ms\":" << milliseconds(times[i].wall)
+            << ",\"cpu_ms\":" << milliseconds(times[i].cpu) << ",\"rss_bytes\":" << resident[i] << "}";
+    }
+    out << "},\"counters\":{\"source_bytes\":" << counters.sourceBytes << ",\"tokens\":" << counters.tokens
+        << ",\"symbols\":" << counters.symbols << ",\"nodes\":{";
+    for (size_t i = 0; i < kNodeKinds; ++i) {
+        out << (i ? "," : "") << "\"" << kNodeNames[i] << "\":" << counters.nodes[i];
+    }
+    out << "},\"ir_functions\":" << counters.irFunctions << ",\"ir_basic_blocks\":" << counters.irBasicBlocks
+        << ",\"ir_instructions\":" << counters.irInstructions << ",\"machine_code_bytes\":" << counters.machineCodeBytes
+        << ",\"peak_rss_bytes\":" << peakResidentBytes() << "}";
+    // Zeros unless heapProfiled
+    out << ",\"heap\":{\"profiled\":" << (heapProfiled ? "true" : "false") << ",\"phases\":{";
+    bool first = true;
+    for (size_t slot : reportedSlots()) {
+        heap_profile::Counters heap = heapProfiled ? heap_profile::counters(slot) : heap_profile::Counters();
+        out << (first ? "" : ",") << "\"" << slotName(slot) << "\":{\"allocations\":" << heap.allocations
+            << ",\"bytes\":" << heap.bytes << ",\"frees\":" << heap.frees << ",\"net_bytes\":" << heap.net
+            << ",\"peak_bytes\":" << heap.peak << "}";
+        first = false;
+    }
+    out << "}}";
+    printEventsJson(out);
+    out << "}\n";
+}
+
+//IPC and miss rates per phase; a rate is n/a when an event it needs is missing
+void Stats::printEvents(std::ostream& out) const {
+    if (!perf->anyAvailable()) {
+        out << "\nHardware counters unavailable: " << perf->error() << "\n";
+        return;
+    }
+    using Event = PerfCounters::Event;
+    auto has = [&](Event event) { return perf->available(event); };
+    auto rates = [&](const char* name, const uint64_t* counts) {
+        auto count = [&](Event event) { return counts[static_cast<size_t>(event)]; };
+        char ipc[32] = "n/a";
+        if (has(Event::CYCLES) && has(Event::INSTRUCTIONS) && count(Event::CYCLES) != 0) {
+            std::snprintf(ipc, sizeof(ipc), "%.2f", static_cast<double>(count(Event::INSTRUCTIONS)) / count(Event::CYCLES));
+        }
+        auto shown = [&](Event event) {
+            return has(event) ? std::to_string(count(event)) : std::string("n/a");
+        };
+        char line[160];
+        std::snprintf(line, sizeof(line), "%-28s %14s %14s %8s %12s %12s %12s\n", name, shown(Event::CYCLES).c_str(),
+                      shown(Event::INSTRUCTIONS).c_str(), ipc,
+                      percent(count(Event::BRANCH_MISSES), count(Event::BRANCHES),
+                              has(Event::BRANCHES) && has(Event::BRANCH_MISSES)).c_str(),
+                      percent(count(Event::L1D_LOAD_MISSES), count(Event::L1D_LOADS),
+                              has(Event::L1D_LOADS) && has(Event::L1D_LOAD_MISSES)).c_str(),
+                      percent(count(Event::LLC_MISSES), count(Event::LLC_REFERENCES),
+                              has(Event::LLC_REFERENCES) && has(Event::LLC_MISSES)).c_str());
+        out << line;
+    };
+
+    char line[160];
+    std::snprintf(line, sizeof(line), "\n%-28s %14s %14s %8s %12s %12s %12s\n", "Hardware", "Cycles", "Instructions",
+                  "IPC", "Branch miss", "L1D miss", "LLC miss");
+    out << line;
+    uint64_t total[PerfCounters::kEvents] = {};
+    for (size_t i = 0; i < std::size(kPhaseNames); ++i) {
+        rates(kPhaseNames[i], events[i]);
+        for (size_t event = 0; event < PerfCounters::kEvents; ++event) {
+            total[event] += events[i][event];
+        }
+    }
+    rates("total", total);
+    if (!perf->error().empty()) {
+        out << "(" << perf->error() << ")\n";
+    }
+}
+
+//Raw counts; null for events that could not be opened
+void Stats::printEventsJson(std::ostream& out) const {
+    bool available = perf && perf->anyAvailable();
+    out << ",\"hardware\":{\"available\":" << (available ? "true" : "false") << ",\"phases\":{";
+    for (size_t i = 0; i < std::size(kPhaseNames); ++i) {
+        out << (i ? "," : "") << "\"" << kPhaseNames[i] << "\":{";
+        for (size_t event = 0; event < PerfCounters::kEvents; ++event) {
+            auto which = static_cast<PerfCounters::Event>(event);
+            out << (event ? "," : "") << "\"" << PerfCounters::eventName(which) << "\":";
+            if (available && perf->available(which)) {
+                out << events[i][event];
+            } else {
+                out << "null";
+            }
+        }
+        out << "}";
+    }
+    out << "}}";
+}
@@ -0,0 +1,131 @@
+//
+//Stats: where a compile spent its time, and how much it produced
+//The driver times each phase with a PhaseTimer and fills in the counters,
+//then prints them for --stats as a table or, for --stats=json, as one JSON
+//object whose keys keep their order within a version; phases that did not
+//run report 0
+//CPU time is the whole process's, so it includes worker threads
+//Each timed phase is also a span of the --trace timeline when LLVM's time
+//trace profiler is running on the calling thread
+//The resident set size is sampled as each phase ends; with heapProfiled set
+//the report adds heap_profile's per-phase allocation counters, and with perf
+//set, each phase's hardware events
+#pragma once
+
+#include "ast.hpp"
+#include "flat_ast.hpp"
+#include "heap_profile.hpp"
+#include "perf_counters.hpp"
+#include <llvm/Support/TimeProfiler.h>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+namespace llvm {
+class Module;
+}
+
+class Stats {
+public:
+    enum class Phase {
+        READ,
+        LEX,
+        PARSE, // also an AST cache load, and lexing when tokens are streamed
+        SEMA,
+        CODEGEN,
+        VERIFY, // includes writing output.ll
+        OPTIMIZE, // the -O pass pipeline
+        JIT_SETUP, // through machine code generation
+        EXECUTE,
+        COUNT
+    };
+
+    struct Time {
+        double wall = 0; // seconds
+        double cpu = 0;
+    };
+
+    static constexpr size_t kNodeKinds = static_cast<size_t>(NodeKind::ASSIGNMENT_STATEMENT) + 1;
+
+    struct Counters {
+        uint64_t sourceBytes = 0;
+        uint64_t tokens = 0;
+        uint64_t symbols = 0;
+        uint64_t nodes[kNodeKinds] = {}; // indexed by NodeKind
+        uint64_t irFunctions = 0;
+        uint64_t irBasicBlocks = 0;
+        uint64_t irInstructions = 0;
+        uint64_t machineCodeBytes = 0;
+    };
+
+    Counters counters;
+    bool heapProfiled = false; // report heap_profile's counters
+    const PerfCounters* perf = nullptr; // read around each phase when set
+
+    void add(Phase phase, const Time& time);
+    static const char* phaseName(Phase phase);
+    const Time& time(Phase phase) const { return times[static_cast<size_t>(phase)]; }
+    // Record the resident set size at the end of a phase
+    void sampleResident(Phase phase) { resident[static_cast<size_t>(phase)] = residentBytes(); }
+    // Add the hardware events between two reads of perf
+    void addEvents(Phase phase, const uint64_t* start, const uint64_t* end);
+
+    // Fill in counters.nodes
+    void countNodes(const Program& program);
+    void countNodes(const FlatAst& ast);
+    // Fill in the ir counters
+    void countIr(const llvm::Module& module);
+
+    void print(std::ostream& out) const;
+    void printJson(std::ostream& out) const;
+
+    // Wall and process CPU time since some fixed point
+    static Time now();
+    // Resident set size now, and its high-water mark, in bytes
+    static uint64_t residentBytes();
+    static uint64_t peakResidentBytes();
+
+private:
+    Time times[static_cast<size_t>(Phase::COUNT)];
+    uint64_t resident[static_cast<size_t>(Phase::COUNT)] = {}; // at the end of the phase's last run
+    uint64_t events[static_cast<size_t>(Phase::COUNT)][PerfCounters::kEvents] = {};
+
+    void printEvents(std::ostream& out) const;
+    void printEventsJson(std::ostream& out) const;
+};
+
+static_assert(static_cast<size_t>(Stats::Phase::COUNT) < heap_profile::kOutside, "too many phases for heap_profile");
+
+//Adds the time from construction to destruction to a phase, and makes it
+//heap_profile's current phase meanwhile
+class PhaseTimer {
+public:
+    PhaseTimer(Stats& stats, Stats::Phase phase)
+        : stats(stats), phase(phase), span(Stats::phaseName(phase)),
+          outerSlot(heap_profile::enter(static_cast<size_t>(phase))), start(Stats::now()) {
+        if (stats.perf) {
+            stats.perf->read(startEvents);
+        }
+    }
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+    ~PhaseTimer() {
+        if (stats.perf) {
+            uint64_t endEvents[PerfCounters::kEvents];
+            stats.perf->read(endEvents);
+            stats.addEvents(phase, startEvents, endEvents);
+        }
+        Stats::Time end = Stats::now();
+        heap_profile::enter(outerSlot);
+        stats.add(phase, Stats::Time{end.wall - start.wall, end.cpu - start.cpu});
+        stats.sampleResident(phase);
+    }
+
+private:
+    Stats& stats;
+    Stats::Phase phase;
+    llvm::TimeTraceScope span;
+    size_t outerSlot;
+    Stats::Time start;
+    uint64_t startEvents[PerfCounters::kEvents];
+};
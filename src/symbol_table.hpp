@@ -0,0 +1,66 @@
+//
+//ScopedSymbolTable: which names are visible during semantic analysis
+//SymbolIds are dense, so the table is a flat array indexed by SymbolId
+//Every declaration is also pushed on an undo log, and a scope is just a mark
+//in that log: leaving it undoes the declarations made since the mark, so
+//entering and leaving a block costs only the declarations inside it
+#pragma once
+
+#include "interner.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ScopedSymbolTable {
+public:
+    //Empties the table for a program with symbolCount interned names
+    void reset(size_t symbolCount) {
+        declared.assign(symbolCount, 0);
+        undoLog.clear();
+        scopeMarks.clear();
+    }
+
+    //Makes room for names interned since reset; they start out undeclared
+    void grow(size_t symbolCount) {
+        if (declared.size() < symbolCount) {
+            declared.resize(symbolCount, 0);
+        }
+    }
+
+    bool isDeclared(SymbolId name) const { return declared[name] != 0; }
+
+    //Makes name visible until the current scope is left; name must not already be visible
+    void declare(SymbolId name) {
+        declared[name] = 1;
+        undoLog.push_back(name);
+    }
+
+    void enterScope() { scopeMarks.push_back(undoLog.size()); }
+
+    void exitScope() {
+        size_t mark = scopeMarks.back();
+        scopeMarks.pop_back();
+        while (undoLog.size() > mark) {
+            declared[undoLog.back()] = 0;
+            undoLog.pop_back();
+        }
+    }
+
+    size_t depth() const { return scopeMarks.size(); }
+
+    //Position in the undo log; rollback(mark()) later closes every scope and
+    //undoes every declaration made in between
+    size_t mark() const { return undoLog.size(); }
+    void rollback(size_t mark) {
+        scopeMarks.clear();
+        while (undoLog.size() > mark) {
+            declared[undoLog.back()] = 0;
+            undoLog.pop_back();
+        }
+    }
+
+private:
+    std::vector<uint8_t> declared; // indexed by SymbolId, nonzero when visible
+    std::vector<SymbolId> undoLog; // declarations in order, innermost scope last
+    std::vector<size_t> scopeMarks; // undoLog size when each open scope was entered
+};
@@ -0,0 +1,19 @@
+#include "token_stream.hpp"
+
+TokenStream::TokenStream(const std::vector<Token>& tokens)
+    : tokens(tokens.data()), count(tokens.size() - 1), eof(tokens.back()) {}
+
+TokenStream::TokenStream(const Token* tokens, size_t count, const Token& eof)
+    : tokens(tokens), count(count), eof(eof) {}
+
+TokenStream::TokenStream(Lexer& lexer) : lexer(&lexer) {}
+
+void TokenStream::pull() {
+    // Once EOF has been produced keep handing it out instead of re-lexing
+    if (filled > 0 && ring[(filled - 1) % kRingSize].type == TokenType::EOF_TOKEN) {
+        ring[filled % kRingSize] = ring[(filled - 1) % kRingSize];
+    } else {
+        ring[filled % kRingSize] = lexer->nextToken();
+    }
+    filled++;
+}
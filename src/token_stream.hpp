@@ -0,0 +1,68 @@
+//
+//TokenStream class definition
+//TokenStream is the Parser's window onto the tokens
+//It either walks a pre-lexed token array or pulls tokens on demand from a Lexer
+//In pull mode only a small fixed-size ring of tokens is kept, so memory is
+//O(1) in the size of the source and errors surface before the file is fully lexed
+#pragma once
+
+#include "lexer.hpp"
+#include <array>
+#include <cassert>
+#include <vector>
+
+class TokenStream {
+public:
+    // Ring capacity: the previous token, the current one and the lookahead
+    static constexpr size_t kRingSize = 4;
+    static constexpr size_t kMaxLookahead = kRingSize - 2;
+
+    // Walks a token array that ends with EOF_TOKEN; tokens must outlive the stream
+    explicit TokenStream(const std::vector<Token>& tokens);
+    TokenStream(std::vector<Token>&&) = delete;
+    // Walks tokens[0, count) and then reports eof, for parsing part of an array
+    TokenStream(const Token* tokens, size_t count, const Token& eof);
+    // Pulls tokens from the lexer as the parser asks for them
+    explicit TokenStream(Lexer& lexer);
+
+    const Token& peek(size_t ahead = 0) {
+        if (tokens) {
+            return position + ahead < count ? tokens[position + ahead] : eof;
+        }
+        assert(ahead <= kMaxLookahead);
+        while (filled <= position + ahead) {
+            pull();
+        }
+        return ring[(position + ahead) % kRingSize];
+    }
+
+    const Token& previous() const {
+        assert(position > 0);
+        if (tokens) {
+            return tokens[position - 1];
+        }
+        return ring[(position - 1) % kRingSize];
+    }
+
+    // Callers must not advance past EOF_TOKEN
+    void advance() {
+        if (!tokens && filled <= position) {
+            pull();
+        }
+        position++;
+    }
+
+    // Number of tokens consumed so far
+    size_t consumed() const { return position; }
+
+private:
+    const Token* tokens = nullptr; // array mode
+    size_t count = 0; // tokens before eof in array mode
+    Token eof;
+    Lexer* lexer = nullptr; // pull mode
+    std::array<Token, kRingSize> ring;
+    size_t position = 0; // index of the current token
+    size_t filled = 0; // tokens pulled from the lexer so far
+
+    void pull();
+};